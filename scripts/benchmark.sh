@@ -0,0 +1,91 @@
+#!/bin/sh
+
+# call in the project root
+# as ./scripts/benchmark.sh [PLATFORM...]
+#
+# Replays the same scenario in the emulator of each platform, all of them by
+# default: the startup animation, an hour of minute ticks from 23:30, a Quick
+# View peek, a config push and the weather replies. Everything stays local,
+# the phone side fetches its weather from scripts/weather_stand_in.js.
+#
+# The benchmark build is made from a copy of the project in
+# build/benchmark/project, with its own environment.js, so that neither the
+# tree nor the normal build in build/ are touched.
+#
+# The logs go to build/benchmark/PLATFORM.log and the timings and counters
+# the face reported to build/benchmark/report.json.
+#
+# BENCHMARK_CONFIG, the settings pushed during the scenario, default to the
+# rainbow mode and the shortest weather refresh rate the settings allow.
+set -e
+
+PEBBLE=${PEBBLE:-pebble}
+PLATFORMS=${*:-aplite basalt chalk diorite emery}
+PORT=${BENCHMARK_PORT:-8734}
+START=${BENCHMARK_START:-1740785400}
+CONFIG=${BENCHMARK_CONFIG:-'{ "AppKeyRainbowMode": 1, "AppKeyRefreshRate": 10, "AppKeyWeatherEnabled": 1 }'}
+TIMEOUT=${BENCHMARK_TIMEOUT:-120}
+OUT=$(pwd)/build/benchmark
+PROJECT=$OUT/project
+
+mkdir -p $OUT
+rm -f $OUT/*.log
+rm -rf $PROJECT
+mkdir $PROJECT
+cp -R package.json package-lock.json wscript src resources $PROJECT
+if [ -d node_modules ]
+then
+    ln -s "$(pwd)/node_modules" $PROJECT/node_modules
+fi
+
+cat > $PROJECT/src/pkjs/environment.js << EOF
+"use strict";
+
+// Written by scripts/benchmark.sh for the benchmark build.
+module.exports = {
+    forecastUrl: 'http://127.0.0.1:$PORT/v1/forecast',
+    geocodeUrl: 'http://127.0.0.1:$PORT/api',
+    location: 'Stand-in',
+    benchmark: {
+        configDelay: 6000,
+        config: $CONFIG
+    }
+};
+EOF
+
+# The trace has to hold the whole scenario.
+(cd $PROJECT && BENCHMARK=$START TRACE_SIZE=512 $PEBBLE build)
+$PEBBLE wipe
+
+node scripts/weather_stand_in.js $PORT > $OUT/stand_in.txt 2>&1 &
+STAND_IN=$!
+trap 'kill $STAND_IN 2> /dev/null || true' EXIT
+trap 'exit 1' INT TERM
+
+# Done once the face sent its counters and the last chunk of its trace.
+reported() {
+    grep -q "energy-day" "$1" && grep -q 'trace [0-9a-f]* (\([0-9]*\)/\1)' "$1"
+}
+
+for P in $PLATFORMS
+do
+    LOG=$OUT/$P.log
+    (cd $PROJECT && $PEBBLE install --emulator $P)
+    $PEBBLE logs --emulator $P > $LOG 2>&1 &
+    LOGS=$!
+    sleep 12
+    $PEBBLE emu-set-timeline-quick-view on --emulator $P
+    sleep 6
+    $PEBBLE emu-set-timeline-quick-view off --emulator $P
+    WAITED=0
+    until reported $LOG || [ $WAITED -ge $TIMEOUT ]
+    do
+        sleep 1
+        WAITED=$((WAITED + 1))
+    done
+    kill $LOGS 2> /dev/null || true
+    $PEBBLE kill
+done
+
+node scripts/benchmark_report.js $(for P in $PLATFORMS; do echo $OUT/$P.log; done) > $OUT/report.json
+echo $OUT/report.json
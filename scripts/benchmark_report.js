@@ -0,0 +1,173 @@
+"use strict";
+
+// Turns the logs of scripts/benchmark.sh into a JSON report: per platform,
+// the frame times and events of the trace the face dumped at the end of the
+// scenario, and its energy counters with their estimated cost.
+// node scripts/benchmark_report.js build/benchmark/PLATFORM.log...
+
+var fs = require('fs');
+var path = require('path');
+var energy = require('../src/pkjs/energy.js');
+
+var REPORT_VERSION = 1;
+
+// As in trace.h.
+var TRACE_VERSION = 1;
+var TRACE_HEADER_SIZE = 14;
+var TRACE_RECORD_SIZE = 8;
+var EVENTS = [null, 'tick', 'bluetooth', 'battery', 'health', 'message', 'outbox',
+    'unob_will', 'unob_change', 'unob_did', 'draw_start', 'draw_end'];
+var DRAW_START = EVENTS.indexOf('draw_start');
+var DRAW_END = EVENTS.indexOf('draw_end');
+
+var TRACE_LINE = /trace ([0-9a-f]+) \((\d+)\/(\d+)\)/;
+var ENERGY_LINE = /energy-day ([0-9a-f]+)/;
+var DONE_LINE = /benchmark done/;
+
+var bytes = function (hex) {
+    var result = [];
+    for (var i = 0; i + 1 < hex.length; i += 2) {
+        result.push(parseInt(hex.substr(i, 2), 16));
+    }
+    return result;
+};
+
+var uint16 = function (data, offset) {
+    return data[offset] | data[offset + 1] << 8;
+};
+
+var uint32 = function (data, offset) {
+    return (data[offset] | data[offset + 1] << 8 | data[offset + 2] << 16 | data[offset + 3] << 24) >>> 0;
+};
+
+// The records of the last complete dump in the log, oldest first, or null.
+var readTrace = function (lines) {
+    var dump = null;
+    var complete = null;
+    lines.forEach(function (line) {
+        var match = TRACE_LINE.exec(line);
+        if (!match) {
+            return;
+        }
+        var data = bytes(match[1]);
+        if (data.length < TRACE_HEADER_SIZE || data[0] !== TRACE_VERSION) {
+            return;
+        }
+        var chunk = data[1];
+        if (chunk === 0) {
+            dump = { recorded: uint32(data, 8), records: [] };
+        } else if (!dump || chunk !== dump.next) {
+            dump = null;
+            return;
+        }
+        for (var i = 0; i < data[3]; i++) {
+            var offset = TRACE_HEADER_SIZE + i * TRACE_RECORD_SIZE;
+            dump.records.push({
+                time: uint32(data, offset),
+                event: data[offset + 4],
+                detail: data[offset + 5],
+                value: uint16(data, offset + 6)
+            });
+        }
+        dump.next = chunk + 1;
+        if (dump.next === data[2]) {
+            complete = dump;
+            dump = null;
+        }
+    });
+    return complete;
+};
+
+var round = function (value) {
+    return Math.round(value * 1000) / 1000;
+};
+
+var stats = function (values) {
+    var total = values.reduce(function (sum, value) {
+        return sum + value;
+    }, 0);
+    return {
+        count: values.length,
+        total_ms: round(total),
+        mean_ms: values.length ? round(total / values.length) : 0,
+        max_ms: values.length ? Math.max.apply(null, values) : 0
+    };
+};
+
+var traceReport = function (trace) {
+    var events = {};
+    var frames = [];
+    var start = -1;
+    var firstFrameEnd = null;
+    trace.records.forEach(function (record) {
+        if (record.event === DRAW_START) {
+            start = record.time;
+        } else if (record.event === DRAW_END) {
+            if (start >= 0) {
+                frames.push(record.time - start);
+            }
+            if (firstFrameEnd === null) {
+                firstFrameEnd = record.time;
+            }
+            start = -1;
+        } else {
+            var name = EVENTS[record.event] || 'unknown';
+            events[name] = (events[name] || 0) + 1;
+        }
+    });
+    var records = trace.records;
+    return {
+        records: records.length,
+        dropped: trace.recorded - records.length,
+        duration_ms: records.length ? records[records.length - 1].time - records[0].time : 0,
+        // Only meaningful when no record was dropped.
+        first_frame_ms: trace.recorded === records.length ? firstFrameEnd : null,
+        frames: stats(frames),
+        events: events
+    };
+};
+
+var platformReport = function (file) {
+    var lines = fs.readFileSync(file, 'utf8').split('\n');
+    var report = { platform: path.basename(file, '.log') };
+    report.done = lines.some(function (line) {
+        return DONE_LINE.test(line);
+    });
+    var trace = readTrace(lines);
+    report.trace = trace ? traceReport(trace) : null;
+    // The scenario crosses midnight: the finished day and the one reported at
+    // the end add up to the whole of it.
+    var days = [];
+    lines.forEach(function (line) {
+        var match = ENERGY_LINE.exec(line);
+        var day = match ? energy.parse(bytes(match[1])) : null;
+        if (day) {
+            days.push(day);
+        }
+    });
+    var scenario = days.length ? {
+        settings: [].concat.apply([], days.map(function (day) { return day.settings; })),
+        hours: [].concat.apply([], days.map(function (day) { return day.hours; }))
+    } : null;
+    report.energy = scenario ? {
+        days: days.length,
+        settings: energy.active(scenario),
+        counters: energy.totals(scenario),
+        costs_uah: energy.estimate(scenario)
+    } : null;
+    report.complete = report.done && report.trace !== null && report.energy !== null;
+    return report;
+};
+
+if (require.main === module) {
+    var platforms = process.argv.slice(2).map(platformReport);
+    console.log(JSON.stringify({ version: REPORT_VERSION, platforms: platforms }, null, 2));
+    process.exitCode = platforms.every(function (platform) {
+        return platform.complete;
+    }) ? 0 : 1;
+}
+
+module.exports = {
+    readTrace: readTrace,
+    platformReport: platformReport
+};
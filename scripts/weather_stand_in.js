@@ -0,0 +1,52 @@
+"use strict";
+
+// Serves the geocoding and forecast requests of the phone side with fixed
+// answers, so that scripts/benchmark.sh runs offline.
+// node scripts/weather_stand_in.js PORT
+
+var http = require('http');
+var url = require('url');
+
+var LONGITUDE = 2.3522;
+var LATITUDE = 48.8566;
+
+var answers = {
+    '/api': function () {
+        return {
+            features: [{
+                geometry: { type: 'Point', coordinates: [LONGITUDE, LATITUDE] },
+                properties: { name: 'Stand-in' }
+            }]
+        };
+    },
+    '/v1/forecast': function () {
+        return {
+            latitude: LATITUDE,
+            longitude: LONGITUDE,
+            current: {
+                // Like Open-Meteo, the start of the 15 minute slot.
+                time: Math.floor(Date.now() / 1000 / 900) * 900,
+                temperature_2m: 12.4,
+                weather_code: 3,
+                is_day: 1
+            }
+        };
+    }
+};
+
+var port = parseInt(process.argv[2], 10) || 8734;
+
+http.createServer(function (request, response) {
+    var path = url.parse(request.url).pathname;
+    var answer = answers[path];
+    console.log(new Date().toISOString() + ' ' + request.method + ' ' + request.url + ' ' + (answer ? 200 : 404));
+    if (!answer) {
+        response.writeHead(404);
+        response.end();
+        return;
+    }
+    response.writeHead(200, { 'Content-Type': 'application/json' });
+    response.end(JSON.stringify(answer()));
+}).listen(port, '127.0.0.1', function () {
+    console.log('weather stand-in on port ' + port);
+});
@@ -2,6 +2,17 @@
 #include <stdlib.h>
 #include "config.h"
 
+#ifndef CONFIG_FROZEN
+
+#define CONF_MAX_KEYS 32
+
+// Record of the unversioned format, only read to migrate existing settings.
+typedef struct
+{
+    int32_t key;
+    int32_t value;
+} __attribute__((packed)) LegacyConfValue;
+
 static Config *config_create(const int32_t size)
 {
     Config *conf = (Config *)malloc(sizeof(Config));
@@ -28,7 +39,7 @@ int8_t config_get_bool(const Config *conf, const int32_t key)
     ConfValue *v = value_for_key(conf, key);
     if (v)
     {
-        return (int8_t) v->value;
+        return (int8_t) v->value.integer;
     }
     return false;
 }
@@ -38,7 +49,7 @@ void config_set_bool(Config *conf, const int32_t key, const int8_t value)
     ConfValue *v = value_for_key(conf, key);
     if (v)
     {
-        v->value = value;
+        v->value.integer = value;
     }
 }
 
@@ -52,7 +63,7 @@ int32_t config_get_int(const Config *conf, const int32_t key)
     ConfValue *v = value_for_key(conf, key);
     if (v)
     {
-        return v->value;
+        return v->value.integer;
     }
     return 0;
 }
@@ -62,32 +73,201 @@ void config_set_int(Config *conf, const int32_t key, const int32_t value)
     ConfValue *v = value_for_key(conf, key);
     if (v)
     {
-        v->value = value;
+        v->value.integer = value;
     }
 }
 
-Config *config_load(const int32_t persist_key, const int32_t size, const ConfValue *defaults)
+// 0xRRGGBB to 0bAARRGGBB and back, lossless for the 64 colors of the watch.
+static uint8_t gcolor8_from_hex(const int32_t hex)
 {
-    Config *conf = config_create(size);
-    const int read_size = persist_read_data(persist_key, conf->data, size * sizeof(ConfValue));
-    if (read_size == E_DOES_NOT_EXIST)
+    return 0xc0 | ((hex >> 22) & 0x3) << 4 | ((hex >> 14) & 0x3) << 2 | ((hex >> 6) & 0x3);
+}
+
+int32_t config_hex_from_gcolor8(const uint8_t argb)
+{
+    return ((argb >> 4) & 0x3) * 0x550000 + ((argb >> 2) & 0x3) * 0x5500 + (argb & 0x3) * 0x55;
+}
+
+// Fletcher-16
+static uint16_t checksum(const uint8_t *data, const size_t size)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (size_t i = 0; i < size; i++)
     {
-        memcpy(conf->data, defaults, size * sizeof(ConfValue));
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
     }
-    else
+    return sum2 << 8 | sum1;
+}
+
+static int32_t key_count(const Config *conf)
+{
+    int32_t count = 0;
+    for (int32_t i = 0; i < conf->size; i++)
     {
-        const int config_size = read_size / sizeof(ConfValue);
-        for (int i = config_size; i < size; i++)
+        if (conf->data[i].key >= count)
         {
-            conf->data[i] = defaults[i];
+            count = conf->data[i].key + 1;
         }
     }
+    return count;
+}
+
+static int config_pack(const Config *conf, uint8_t *buffer, const size_t buffer_size)
+{
+    const int32_t count = key_count(conf);
+    uint8_t *body = buffer + sizeof(ConfHeader);
+    uint32_t bools = 0;
+    size_t offset = sizeof(bools);
+    for (int32_t key = 0; key < count; key++)
+    {
+        const ConfValue *v = value_for_key(conf, key);
+        if (!v || sizeof(ConfHeader) + offset + sizeof(int16_t) > buffer_size)
+        {
+            return 0;
+        }
+        switch (v->type)
+        {
+        case BoolConf:
+            bools |= (v->value.integer ? 1u : 0u) << key;
+            break;
+        case ColorConf:
+            body[offset++] = gcolor8_from_hex(v->value.integer);
+            break;
+        case IntConf:
+        {
+            const int16_t value = v->value.integer;
+            memcpy(&body[offset], &value, sizeof(value));
+            offset += sizeof(value);
+            break;
+        }
+        }
+    }
+    memcpy(body, &bools, sizeof(bools));
+    const ConfHeader header = {
+        .version = CONF_VERSION,
+        .count = count,
+        .checksum = checksum(body, offset)};
+    memcpy(buffer, &header, sizeof(header));
+    return sizeof(header) + offset;
+}
+
+static bool config_unpack(Config *conf, const uint8_t *buffer, const int size)
+{
+    ConfHeader header;
+    uint32_t bools;
+    if (size < (int)(sizeof(header) + sizeof(bools)))
+    {
+        return false;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    const uint8_t *body = buffer + sizeof(header);
+    const size_t body_size = size - sizeof(header);
+    if (header.version != CONF_VERSION || header.count > CONF_MAX_KEYS || header.checksum != checksum(body, body_size))
+    {
+        return false;
+    }
+    memcpy(&bools, body, sizeof(bools));
+    size_t offset = sizeof(bools);
+    for (int32_t key = 0; key < header.count; key++)
+    {
+        ConfValue *v = value_for_key(conf, key);
+        if (!v)
+        {
+            return false;
+        }
+        const size_t width = v->type == ColorConf ? 1 : v->type == IntConf ? sizeof(int16_t) : 0;
+        if (offset + width > body_size)
+        {
+            return false;
+        }
+        switch (v->type)
+        {
+        case BoolConf:
+            v->value.integer = (bools >> key) & 1;
+            break;
+        case ColorConf:
+            v->value.integer = config_hex_from_gcolor8(body[offset]);
+            break;
+        case IntConf:
+        {
+            int16_t value;
+            memcpy(&value, &body[offset], sizeof(value));
+            v->value.integer = value;
+            break;
+        }
+        }
+        offset += width;
+    }
+    return true;
+}
+
+// Values are matched by key, so neither the order nor the number of the
+// records matters.
+static bool config_migrate(Config *conf, const uint8_t *buffer, const int size)
+{
+    if (size <= 0 || size % sizeof(LegacyConfValue) != 0)
+    {
+        return false;
+    }
+    const LegacyConfValue *records = (const LegacyConfValue *)buffer;
+    const int count = size / sizeof(LegacyConfValue);
+    for (int i = 0; i < count; i++)
+    {
+        if (records[i].key < 0 || records[i].key >= CONF_MAX_KEYS)
+        {
+            return false;
+        }
+    }
+    for (int i = 0; i < count; i++)
+    {
+        config_set_int(conf, records[i].key, records[i].value);
+    }
+    return true;
+}
+
+Config *config_load(const int32_t persist_key, const int32_t size, const ConfValue *defaults)
+{
+    Config *conf = config_create(size);
+    memcpy(conf->data, defaults, size * sizeof(ConfValue));
+    uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+    const int read_size = persist_read_data(persist_key, buffer, sizeof(buffer));
+    if (read_size == E_DOES_NOT_EXIST || config_unpack(conf, buffer, read_size))
+    {
+        return conf;
+    }
+    memcpy(conf->data, defaults, size * sizeof(ConfValue));
+    if (config_migrate(conf, buffer, read_size))
+    {
+        config_save(conf, persist_key);
+    }
     return conf;
 }
 
-void config_save(Config *conf, const int32_t persist_key)
+// Returns the number of bytes written, like persist_write_data.
+int config_save(Config *conf, const int32_t persist_key)
 {
-    persist_write_data(persist_key, conf->data, conf->size * sizeof(ConfValue));
+    uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+    const int size = config_pack(conf, buffer, sizeof(buffer));
+    if (size > 0)
+    {
+        return persist_write_data(persist_key, buffer, size);
+    }
+    return 0;
+}
+
+// Identifies the values in use, the same whichever way they were set.
+uint16_t config_checksum(const Config *conf)
+{
+    uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+    if (config_pack(conf, buffer, sizeof(buffer)) == 0)
+    {
+        return 0;
+    }
+    ConfHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    return header.checksum;
 }
 
 Config *config_destroy(Config *conf)
@@ -96,3 +276,5 @@ Config *config_destroy(Config *conf)
     free(conf);
     return NULL;
 }
+
+#endif
@@ -1,12 +1,37 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
+typedef enum
+{
+    BoolConf = 0,
+    ColorConf,
+    IntConf
+} ConfType;
+
+typedef union
+{
+    int32_t integer;
+    bool boolean;
+} ConfData;
+
 typedef struct
 {
     int32_t key;
-    int32_t value;
-} __attribute__((packed)) ConfValue;
+    ConfType type;
+    ConfData value;
+} ConfValue;
+
+// Persisted header, followed by a bitfield of the bools indexed by key, then
+// one GColor8 byte per color and an int16 per int, in ascending key order.
+// Only keys below count are stored, keys added later take their default.
+typedef struct
+{
+    uint8_t version;
+    uint8_t count;
+    uint16_t checksum;
+} __attribute__((packed)) ConfHeader;
 
 typedef struct
 {
@@ -14,14 +39,6 @@ typedef struct
     int32_t size;
 } Config;
 
-int8_t config_get_bool(const Config *conf, const int32_t key);
-void config_set_bool(Config *conf, const int32_t key, const int8_t value);
-GColor config_get_color(const Config *conf, const int32_t key);
-int32_t config_get_int(const Config *conf, const int32_t key);
-void config_set_int(Config *conf, const int32_t key, const int32_t value);
-Config *config_load(const int32_t persist_key, int32_t size, const ConfValue *defaults);
-void config_save(Config *conf, const int32_t persist_key);
-Config *config_destroy(Config *conf);
 
 typedef enum
 {
@@ -42,13 +59,35 @@ typedef enum
     ConfigKeyHealthEnabled,
     ConfigKeyBatteryDisplayedAt,
     ConfigKeyQuietTimeVisible,
-    ConfigKeyAnimationEnabled
+    ConfigKeyAnimationEnabled,
+    ConfigKeyStepRingEnabled
 } ConfigKey;
 
-#define CONF_SIZE 18
+#define CONF_SIZE 19
 
-#define CONF_VERSION 2
+#define CONF_VERSION 3
 
+#ifndef CONFIG_MINUTE_HAND_COLOR
+#define CONFIG_MINUTE_HAND_COLOR 0xffffff
+#endif
+#ifndef CONFIG_HOUR_HAND_COLOR
+#define CONFIG_HOUR_HAND_COLOR PBL_IF_COLOR_ELSE(0xff0000, 0xffffff)
+#endif
+#ifndef CONFIG_BACKGROUND_COLOR
+#define CONFIG_BACKGROUND_COLOR 0x000000
+#endif
+#ifndef CONFIG_DATE_COLOR
+#define CONFIG_DATE_COLOR PBL_IF_COLOR_ELSE(0x555555, 0xffffff)
+#endif
+#ifndef CONFIG_TIME_COLOR
+#define CONFIG_TIME_COLOR PBL_IF_COLOR_ELSE(0xaaaaaa, 0xffffff)
+#endif
+#ifndef CONFIG_INFO_COLOR
+#define CONFIG_INFO_COLOR PBL_IF_COLOR_ELSE(0x555555, 0xffffff)
+#endif
+#ifndef CONFIG_REFRESH_RATE
+#define CONFIG_REFRESH_RATE 20
+#endif
 #ifndef CONFIG_BLUETOOTH_ICON
 #define CONFIG_BLUETOOTH_ICON Bluetooth
 #endif
@@ -67,3 +106,65 @@ typedef enum
 #ifndef CONFIG_MILITARY_TIME
 #define CONFIG_MILITARY_TIME false
 #endif
+#ifndef CONFIG_VIBRATE_ON_THE_HOUR
+#define CONFIG_VIBRATE_ON_THE_HOUR false
+#endif
+#ifndef CONFIG_HEALTH_ENABLED
+#define CONFIG_HEALTH_ENABLED false
+#endif
+#ifndef CONFIG_BATTERY_DISPLAYED_AT
+#define CONFIG_BATTERY_DISPLAYED_AT -1
+#endif
+#ifndef CONFIG_QUIET_TIME_VISIBLE
+#define CONFIG_QUIET_TIME_VISIBLE true
+#endif
+#ifndef CONFIG_ANIMATION_ENABLED
+#define CONFIG_ANIMATION_ENABLED true
+#endif
+#ifndef CONFIG_STEP_RING_ENABLED
+#define CONFIG_STEP_RING_ENABLED false
+#endif
+
+#ifdef CONFIG_FROZEN
+
+// Frozen builds compile the defaults above in: every getter folds to a
+// constant, nothing is loaded or persisted and settings from the phone are
+// ignored.
+#define FROZEN_ConfigKeyMinuteHandColor CONFIG_MINUTE_HAND_COLOR
+#define FROZEN_ConfigKeyHourHandColor CONFIG_HOUR_HAND_COLOR
+#define FROZEN_ConfigKeyBackgroundColor CONFIG_BACKGROUND_COLOR
+#define FROZEN_ConfigKeyDateColor CONFIG_DATE_COLOR
+#define FROZEN_ConfigKeyTimeColor CONFIG_TIME_COLOR
+#define FROZEN_ConfigKeyInfoColor CONFIG_INFO_COLOR
+#define FROZEN_ConfigKeyRefreshRate CONFIG_REFRESH_RATE
+#define FROZEN_ConfigKeyTemperatureUnit CONFIG_TEMPERATURE_UNIT
+#define FROZEN_ConfigKeyBluetoothIcon CONFIG_BLUETOOTH_ICON
+#define FROZEN_ConfigKeyWeatherEnabled CONFIG_WEATHER_ENABLED
+#define FROZEN_ConfigKeyRainbowMode PBL_IF_COLOR_ELSE(CONFIG_RAINBOW_MODE, false)
+#define FROZEN_ConfigKeyDateDisplayed CONFIG_DATE_DISPLAYED
+#define FROZEN_ConfigKeyVibrateOnTheHour CONFIG_VIBRATE_ON_THE_HOUR
+#define FROZEN_ConfigKeyVersion CONF_VERSION
+#define FROZEN_ConfigKeyHealthEnabled CONFIG_HEALTH_ENABLED
+#define FROZEN_ConfigKeyBatteryDisplayedAt CONFIG_BATTERY_DISPLAYED_AT
+#define FROZEN_ConfigKeyQuietTimeVisible CONFIG_QUIET_TIME_VISIBLE
+#define FROZEN_ConfigKeyAnimationEnabled CONFIG_ANIMATION_ENABLED
+#define FROZEN_ConfigKeyStepRingEnabled CONFIG_STEP_RING_ENABLED
+
+#define config_get_bool(conf, key) ((void)(conf), (int8_t)(FROZEN_##key))
+#define config_get_int(conf, key) ((void)(conf), (int32_t)(FROZEN_##key))
+#define config_get_color(conf, key) ((void)(conf), GColorFromHEX(FROZEN_##key))
+
+#else
+
+int8_t config_get_bool(const Config *conf, const int32_t key);
+void config_set_bool(Config *conf, const int32_t key, const int8_t value);
+GColor config_get_color(const Config *conf, const int32_t key);
+int32_t config_get_int(const Config *conf, const int32_t key);
+void config_set_int(Config *conf, const int32_t key, const int32_t value);
+Config *config_load(const int32_t persist_key, int32_t size, const ConfValue *defaults);
+int config_save(Config *conf, const int32_t persist_key);
+uint16_t config_checksum(const Config *conf);
+int32_t config_hex_from_gcolor8(const uint8_t argb);
+Config *config_destroy(Config *conf);
+
+#endif
@@ -0,0 +1,126 @@
+#include <pebble.h>
+#include "energy.h"
+
+static EnergyDay s_day;
+static int s_hour;
+static int s_saved_hour;
+static uint16_t s_pixels;
+
+static void energy_start_day(const int32_t today, const int hour)
+{
+    memset(&s_day, 0, sizeof(EnergyDay));
+    s_day.version = ENERGY_VERSION;
+    s_day.counters = ENERGY_COUNTERS;
+    s_day.day = today;
+    s_hour = hour;
+    s_saved_hour = -1;
+    s_pixels = 0;
+}
+
+static void energy_report(EnergyReportHandler report)
+{
+    if (s_day.day != 0 && report)
+    {
+        report((const uint8_t *)&s_day, sizeof(EnergyDay));
+    }
+}
+
+// Counts of the day so far survive relaunches, a day that ended while the
+// face was not running is reported at the next launch.
+void energy_load(const uint32_t persist_key, const int32_t today, const int hour, EnergyReportHandler report)
+{
+    uint8_t *const bytes = (uint8_t *)&s_day;
+    int read = 0;
+    for (unsigned int i = 0; i < ENERGY_PERSIST_KEYS; i++)
+    {
+        const int size = persist_read_data(persist_key + i, bytes + read, sizeof(EnergyDay) - read);
+        read += size > 0 ? size : 0;
+    }
+    if (read != sizeof(EnergyDay) || s_day.version != ENERGY_VERSION || s_day.counters != ENERGY_COUNTERS)
+    {
+        energy_start_day(today, hour);
+        return;
+    }
+    if (s_day.day != today)
+    {
+        energy_report(report);
+        energy_start_day(today, hour);
+        return;
+    }
+    s_hour = hour;
+    s_saved_hour = hour;
+}
+
+static int energy_chunk_size(const unsigned int chunk)
+{
+    const int offset = chunk * PERSIST_DATA_MAX_LENGTH;
+    return sizeof(EnergyDay) - offset < PERSIST_DATA_MAX_LENGTH ? sizeof(EnergyDay) - offset : PERSIST_DATA_MAX_LENGTH;
+}
+
+// The face exits whenever a menu or an app is opened, so the day is only
+// written once per hour: the counts of an hour that was already saved may be
+// lost. The writes are counted before they are made, so that they are part of
+// what is saved.
+void energy_save(const uint32_t persist_key)
+{
+    if (s_hour == s_saved_hour)
+    {
+        return;
+    }
+    s_saved_hour = s_hour;
+    for (unsigned int i = 0; i < ENERGY_PERSIST_KEYS; i++)
+    {
+        energy_count_persist(energy_chunk_size(i));
+    }
+    const uint8_t *const bytes = (const uint8_t *)&s_day;
+    for (unsigned int i = 0; i < ENERGY_PERSIST_KEYS; i++)
+    {
+        persist_write_data(persist_key + i, bytes + i * PERSIST_DATA_MAX_LENGTH, energy_chunk_size(i));
+    }
+}
+
+// Called on every tick: a new day reports the finished one before the counts
+// start over.
+void energy_roll(const int32_t today, const int hour, EnergyReportHandler report)
+{
+    if (today != s_day.day)
+    {
+        energy_report(report);
+        energy_start_day(today, hour);
+    }
+    s_hour = hour;
+}
+
+// The counts so far, without starting over, for benchmarks.
+void energy_report_today(EnergyReportHandler report)
+{
+    energy_report(report);
+}
+
+void energy_note_settings(const uint8_t refresh_rate, const uint8_t flags)
+{
+    s_day.settings[s_hour] = (EnergySettings){.refresh_rate = refresh_rate, .flags = flags};
+}
+
+void energy_count(const EnergyCounter counter, const uint32_t amount)
+{
+    uint16_t *const count = &s_day.hours[s_hour][counter];
+    *count = amount < (uint32_t)(UINT16_MAX - *count) ? *count + amount : UINT16_MAX;
+}
+
+// Kept in thousands of pixels, the rest carries over to the next frame.
+void energy_count_pixels(const uint32_t pixels)
+{
+    const uint32_t total = s_pixels + pixels;
+    energy_count(EnergyKilopixels, total / 1000);
+    s_pixels = total % 1000;
+}
+
+void energy_count_persist(const int size)
+{
+    if (size > 0)
+    {
+        energy_count(EnergyPersistWrites, 1);
+        energy_count(EnergyPersistBytes, size);
+    }
+}
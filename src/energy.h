@@ -0,0 +1,75 @@
+#pragma once
+
+#include <pebble.h>
+
+#define ENERGY_VERSION 2
+#define ENERGY_HOURS 24
+
+// What costs battery, counted as the face runs. Each count goes to the hour
+// of the day it happened in and saturates there.
+typedef enum
+{
+    EnergyFrames = 0,
+    EnergyKilopixels,
+    EnergyDrawCalls,
+    EnergyRedrawRing,
+    EnergyRedrawText,
+    EnergyRedrawTicks,
+    EnergyRedrawHands,
+    EnergyRedrawRainbow,
+    EnergyMessagesIn,
+    EnergyBytesIn,
+    EnergyMessagesOut,
+    EnergyBytesOut,
+    EnergyPersistWrites,
+    EnergyPersistBytes,
+    EnergyHealthCalls,
+    EnergyVibrations,
+    EnergyTimerWakeups,
+    EnergyTicks
+} EnergyCounter;
+
+#define ENERGY_COUNTERS (EnergyTicks + 1)
+
+// The settings an hour was counted with, as they were at its last tick. The
+// low bits of flags hold the PowerProfile. Hours the face did not run in
+// stay zero.
+typedef enum
+{
+    EnergySettingsProfile = 0x03,
+    EnergySettingsRainbow = 0x04,
+    EnergySettingsWeather = 0x08,
+    EnergySettingsHealth = 0x10
+} EnergySettingsFlag;
+
+typedef struct
+{
+    uint8_t refresh_rate;
+    uint8_t flags;
+} EnergySettings;
+
+// Both the AppKeyEnergy payload and the persisted record, little endian and
+// without padding.
+typedef struct
+{
+    uint8_t version;
+    uint8_t counters;
+    uint16_t reserved;
+    int32_t day;
+    EnergySettings settings[ENERGY_HOURS];
+    uint16_t hours[ENERGY_HOURS][ENERGY_COUNTERS];
+} EnergyDay;
+
+// The day takes several persist keys from the one given on.
+#define ENERGY_PERSIST_KEYS ((sizeof(EnergyDay) + PERSIST_DATA_MAX_LENGTH - 1) / PERSIST_DATA_MAX_LENGTH)
+
+typedef void (*EnergyReportHandler)(const uint8_t *data, const uint16_t size);
+
+void energy_load(const uint32_t persist_key, const int32_t today, const int hour, EnergyReportHandler report);
+void energy_save(const uint32_t persist_key);
+void energy_roll(const int32_t today, const int hour, EnergyReportHandler report);
+void energy_report_today(EnergyReportHandler report);
+void energy_note_settings(const uint8_t refresh_rate, const uint8_t flags);
+void energy_count(const EnergyCounter counter, const uint32_t amount);
+void energy_count_pixels(const uint32_t pixels);
+void energy_count_persist(const int size);
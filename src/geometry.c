@@ -18,7 +18,8 @@ bool intersect(const Segment seg, const GRect frame)
     {
         return false;
     }
-    int coef = ((tail.y - head.y) << 8) / (tail.x - head.x);
+    // A division by zero yields zero on the watch, do the same everywhere.
+    int coef = tail.x != head.x ? ((tail.y - head.y) << 8) / (tail.x - head.x) : 0;
     int y = ((coef * (x_min - head.x)) >> 8) + head.y;
     if (y > y_min && y < y_max)
     {
@@ -30,7 +31,7 @@ bool intersect(const Segment seg, const GRect frame)
         return true;
     }
 
-    coef = ((tail.x - head.x) << 8) / (tail.y - head.y);
+    coef = tail.y != head.y ? ((tail.x - head.x) << 8) / (tail.y - head.y) : 0;
     int x = ((coef * (y_min - head.y)) >> 8) + head.x;
     if (x > x_min && x < x_max)
     {
@@ -52,14 +53,19 @@ int angle(const int value, const int max)
 }
 
 
+// Position of the hour hand out of 600 steps, 50 per hour.
+int hour_step(const tm *const time)
+{
+    return (time->tm_hour % 12) * 50 + time->tm_min * 50 / 60;
+}
+
 int angle_hour(const tm *const time, const bool with_delta)
 {
-    const int hour = time->tm_hour % 12;
     if (with_delta)
     {
-        return angle(hour * 50 + time->tm_min * 50 / 60, 600);
+        return angle(hour_step(time), 600);
     }
-    return angle(hour, 12);
+    return angle(time->tm_hour % 12, 12);
 }
 
 int angle_minute(const tm *const time)
@@ -14,6 +14,7 @@ typedef struct
 
 int angle(const int value, const int max);
 bool intersect(const Segment seg, const GRect frame);
+int hour_step(const tm *const time);
 int angle_hour(const tm *const time, const bool with_delta);
 int angle_minute(const tm *const time);
 GPoint gpoint_on_circle(const GPoint center, const int angle, const int radius);
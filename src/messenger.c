@@ -1,12 +1,13 @@
 #include <pebble.h>
 #include <stdlib.h>
 #include "messenger.h"
+#include "trace.h"
+#include "energy.h"
 
 #define i(string, ...) APP_LOG (APP_LOG_LEVEL_INFO, string, ##__VA_ARGS__)
 
-static void inbox_received_handler(DictionaryIterator *iter, void *context)
+static void inbox_process(Messenger *messenger, DictionaryIterator *iter)
 {
-    Messenger *messenger = (Messenger *)context;
     Tuple *tuple = dict_read_first(iter);
     while (tuple)
     {
@@ -15,6 +16,7 @@ static void inbox_received_handler(DictionaryIterator *iter, void *context)
             Message m = messenger->messages[i];
             if (m.key == tuple->key && m.callback != NULL)
             {
+                trace_record(TraceEventMessage, 0, tuple->key);
                 m.callback(iter, tuple);
             }
         }
@@ -23,22 +25,261 @@ static void inbox_received_handler(DictionaryIterator *iter, void *context)
     messenger->callback(iter);
 }
 
+static void inbox_process_staged(Messenger *messenger)
+{
+    messenger->inbox_timer = NULL;
+    while (messenger->inbox_count > 0)
+    {
+        const StagedMessage staged = messenger->inbox[0];
+        messenger->inbox_count--;
+        memmove(messenger->inbox, messenger->inbox + 1, messenger->inbox_count * sizeof(StagedMessage));
+        DictionaryIterator iter;
+        dict_read_begin_from_buffer(&iter, staged.buffer, staged.size);
+        inbox_process(messenger, &iter);
+        free(staged.buffer);
+    }
+}
+
+static void inbox_staged_callback(void *context)
+{
+    energy_count(EnergyTimerWakeups, 1);
+    inbox_process_staged((Messenger *)context);
+}
+
+// The received dictionary is only copied here, so that the message is
+// acknowledged right away. Applying it, with its flash writes and relayout,
+// happens on the next turn of the event loop.
+static void inbox_received_handler(DictionaryIterator *iter, void *context)
+{
+    Messenger *messenger = (Messenger *)context;
+    const uint16_t size = dict_size(iter);
+    energy_count(EnergyMessagesIn, 1);
+    energy_count(EnergyBytesIn, size);
+    uint8_t *const buffer = messenger->inbox_count < INBOX_STAGING_SIZE ? (uint8_t *)malloc(size) : NULL;
+    if (buffer == NULL)
+    {
+        // Keep the order of the messages when they can't be staged.
+        if (messenger->inbox_timer)
+        {
+            app_timer_cancel(messenger->inbox_timer);
+        }
+        inbox_process_staged(messenger);
+        inbox_process(messenger, iter);
+        return;
+    }
+    memcpy(buffer, iter->dictionary, size);
+    messenger->inbox[messenger->inbox_count++] = (StagedMessage){.buffer = buffer, .size = size};
+    if (!messenger->inbox_timer)
+    {
+        messenger->inbox_timer = app_timer_register(0, inbox_staged_callback, messenger);
+    }
+}
+
+// Outbox
+
+static void outbox_flush(Messenger *messenger);
+
+static void outbox_retry_callback(void *context)
+{
+    Messenger *messenger = (Messenger *)context;
+    messenger->retry_timer = NULL;
+    energy_count(EnergyTimerWakeups, 1);
+    outbox_flush(messenger);
+}
+
+// Capped exponential backoff with equal jitter, so that a phone that stays
+// offline costs fewer and fewer radio attempts.
+static void outbox_schedule_retry(Messenger *messenger)
+{
+    if (messenger->retry_timer)
+    {
+        return;
+    }
+    int delay = OUTBOX_BASE_DELAY;
+    for (int retry = 0; retry < messenger->retries && delay < OUTBOX_MAX_DELAY; retry++)
+    {
+        delay *= 2;
+    }
+    if (delay > OUTBOX_MAX_DELAY)
+    {
+        delay = OUTBOX_MAX_DELAY;
+    }
+    delay = delay / 2 + rand() % (delay / 2 + 1);
+    messenger->retry_timer = app_timer_register(delay, outbox_retry_callback, messenger);
+}
+
+static void outbox_pop(Messenger *messenger, const bool delivered)
+{
+    const uint32_t key = messenger->outbox[0].key;
+    free(messenger->outbox[0].data);
+    messenger->outbox_count--;
+    memmove(messenger->outbox, messenger->outbox + 1, messenger->outbox_count * sizeof(OutboxMessage));
+    messenger->retries = 0;
+    trace_record(TraceEventOutbox, delivered, key);
+    if (messenger->outbox_callback)
+    {
+        messenger->outbox_callback(key, delivered);
+    }
+}
+
+static void outbox_failed(Messenger *messenger)
+{
+    messenger->stats.failures++;
+    messenger->retries++;
+    if (messenger->retries > OUTBOX_MAX_RETRIES)
+    {
+        messenger->stats.drops++;
+        i("outbox dropped key %d after %d attempts", (int)messenger->outbox[0].key, OUTBOX_MAX_RETRIES + 1);
+        outbox_pop(messenger, false);
+        if (messenger->outbox_count == 0)
+        {
+            return;
+        }
+    }
+    outbox_schedule_retry(messenger);
+}
+
+static void outbox_flush(Messenger *messenger)
+{
+    if (messenger->sending || messenger->retry_timer || messenger->outbox_count == 0)
+    {
+        return;
+    }
+    const OutboxMessage *const message = &messenger->outbox[0];
+    messenger->stats.attempts++;
+    DictionaryIterator *out_iter;
+    AppMessageResult result = app_message_outbox_begin(&out_iter);
+    if (result == APP_MSG_OK)
+    {
+        if (message->data)
+        {
+            dict_write_data(out_iter, message->key, message->data, message->size);
+        }
+        else
+        {
+            dict_write_int(out_iter, message->key, &message->value, sizeof(int32_t), true);
+        }
+        result = app_message_outbox_send();
+    }
+    if (result == APP_MSG_OK)
+    {
+        messenger->sending = true;
+        // A dictionary of one tuple: its count, then key, type, length and value.
+        energy_count(EnergyMessagesOut, 1);
+        energy_count(EnergyBytesOut, 1 + 7 + (message->data ? message->size : sizeof(int32_t)));
+    }
+    else
+    {
+        outbox_failed(messenger);
+    }
+}
+
+static void outbox_sent_handler(DictionaryIterator *iter, void *context)
+{
+    Messenger *messenger = (Messenger *)context;
+    messenger->sending = false;
+    messenger->stats.successes++;
+    outbox_pop(messenger, true);
+    outbox_flush(messenger);
+}
+
+static void outbox_failed_handler(DictionaryIterator *iter, AppMessageResult reason, void *context)
+{
+    Messenger *messenger = (Messenger *)context;
+    messenger->sending = false;
+    outbox_failed(messenger);
+}
+
+static bool outbox_push(Messenger *messenger, const uint32_t key, const int32_t value, const bool once)
+{
+    for (int i = 0; i < messenger->outbox_count && !once; i++)
+    {
+        // The head may already be in flight, only pending requests are coalesced.
+        const bool in_flight = i == 0 && messenger->sending;
+        if (messenger->outbox[i].key == key && !messenger->outbox[i].data && !messenger->outbox[i].once && !in_flight)
+        {
+            messenger->outbox[i].value = value;
+            messenger->stats.coalesced++;
+            return true;
+        }
+    }
+    if (messenger->outbox_count >= OUTBOX_SIZE)
+    {
+        messenger->stats.drops++;
+        return false;
+    }
+    messenger->outbox[messenger->outbox_count++] = (OutboxMessage){.key = key, .value = value, .data = NULL, .once = once};
+    outbox_flush(messenger);
+    return true;
+}
+
+// A pending send of the same key takes the new value instead.
+bool messenger_send(Messenger *messenger, const uint32_t key, const int32_t value)
+{
+    return outbox_push(messenger, key, value, false);
+}
+
+// For values that must reach the phone as they are, e.g. an acknowledgement.
+bool messenger_send_once(Messenger *messenger, const uint32_t key, const int32_t value)
+{
+    return outbox_push(messenger, key, value, true);
+}
+
+// Byte arrays are copied and never coalesced, each one is sent in order.
+bool messenger_send_data(Messenger *messenger, const uint32_t key, const uint8_t *data, const uint16_t size)
+{
+    uint8_t *const copy = messenger->outbox_count < OUTBOX_SIZE ? (uint8_t *)malloc(size) : NULL;
+    if (copy == NULL)
+    {
+        messenger->stats.drops++;
+        return false;
+    }
+    memcpy(copy, data, size);
+    messenger->outbox[messenger->outbox_count++] = (OutboxMessage){.key = key, .data = copy, .size = size};
+    outbox_flush(messenger);
+    return true;
+}
+
+void messenger_set_outbox_callback(Messenger *messenger, MessengerOutboxCallback callback)
+{
+    messenger->outbox_callback = callback;
+}
+
 Messenger *messenger_create(const int32_t size, MessengerCallback callback, const Message *messages)
 {
-    Messenger *messenger = (Messenger *)malloc(sizeof(Messenger));
+    Messenger *messenger = (Messenger *)calloc(1, sizeof(Messenger));
     int32_t array_size = size * sizeof(Message);
     messenger->messages = (Message *)malloc(array_size);
     memcpy(messenger->messages, messages, array_size);
     messenger->callback = callback;
     messenger->size = size;
+    srand(time(NULL));
     app_message_set_context(messenger);
     app_message_register_inbox_received(inbox_received_handler);
-    app_message_open(2048, 2048);
+    app_message_register_outbox_sent(outbox_sent_handler);
+    app_message_register_outbox_failed(outbox_failed_handler);
+    app_message_open(MESSENGER_INBOX_SIZE, MESSENGER_OUTBOX_SIZE);
     return messenger;
 }
 
 Messenger *messenger_destroy(Messenger *messenger)
 {
+    if (messenger->retry_timer)
+    {
+        app_timer_cancel(messenger->retry_timer);
+    }
+    if (messenger->inbox_timer)
+    {
+        app_timer_cancel(messenger->inbox_timer);
+    }
+    for (int i = 0; i < messenger->inbox_count; i++)
+    {
+        free(messenger->inbox[i].buffer);
+    }
+    for (int i = 0; i < messenger->outbox_count; i++)
+    {
+        free(messenger->outbox[i].data);
+    }
     free(messenger->messages);
     free(messenger);
     return NULL;
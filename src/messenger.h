@@ -2,6 +2,15 @@
 
 typedef void (*MessageCallback)(DictionaryIterator *iter, Tuple *tuple);
 typedef void (*MessengerCallback)(DictionaryIterator *iter);
+typedef void (*MessengerOutboxCallback)(const uint32_t key, const bool delivered);
+
+#define MESSENGER_INBOX_SIZE 2048
+#define MESSENGER_OUTBOX_SIZE 2048
+#define INBOX_STAGING_SIZE 4
+#define OUTBOX_SIZE 4
+#define OUTBOX_BASE_DELAY 5000
+#define OUTBOX_MAX_DELAY (10 * 60 * 1000)
+#define OUTBOX_MAX_RETRIES 6
 
 typedef struct
 {
@@ -9,12 +18,52 @@ typedef struct
     MessageCallback callback;
 } Message;
 
+// Either an integer or, when data is set, a byte array owned by the outbox.
+// Integers sent once are never coalesced with other sends of their key.
+typedef struct
+{
+    uint32_t key;
+    int32_t value;
+    uint8_t *data;
+    uint16_t size;
+    bool once;
+} OutboxMessage;
+
+typedef struct
+{
+    uint8_t *buffer;
+    uint16_t size;
+} StagedMessage;
+
+typedef struct
+{
+    uint16_t attempts;
+    uint16_t successes;
+    uint16_t failures;
+    uint16_t coalesced;
+    uint16_t drops;
+} OutboxStats;
+
 typedef struct
 {
     Message *messages;
     MessengerCallback callback;
     int32_t size;
+    StagedMessage inbox[INBOX_STAGING_SIZE];
+    int inbox_count;
+    AppTimer *inbox_timer;
+    OutboxMessage outbox[OUTBOX_SIZE];
+    int outbox_count;
+    bool sending;
+    int retries;
+    AppTimer *retry_timer;
+    MessengerOutboxCallback outbox_callback;
+    OutboxStats stats;
 } Messenger;
 
 Messenger *messenger_create(const int32_t size, MessengerCallback callback, const Message *messages);
 Messenger *messenger_destroy(Messenger *messenger);
+void messenger_set_outbox_callback(Messenger *messenger, MessengerOutboxCallback callback);
+bool messenger_send(Messenger *messenger, const uint32_t key, const int32_t value);
+bool messenger_send_once(Messenger *messenger, const uint32_t key, const int32_t value);
+bool messenger_send_data(Messenger *messenger, const uint32_t key, const uint8_t *data, const uint16_t size);
@@ -8,11 +8,29 @@
 #include "geometry.h"
 #include "globals.h"
 #include "tick_points.h"
+#include "step_ring.h"
+#include "power.h"
+#include "solar.h"
+#include "time_state.h"
+#include "trace.h"
+#include "energy.h"
 
 // #define d(string, ...) APP_LOG (APP_LOG_LEVEL_DEBUG, string, ##__VA_ARGS__)
 // #define e(string, ...) APP_LOG (APP_LOG_LEVEL_ERROR, string, ##__VA_ARGS__)
 #define i(string, ...) APP_LOG (APP_LOG_LEVEL_INFO, string, ##__VA_ARGS__)
 
+// Frozen builds leave out the settings handlers, and the handlers, layers and
+// resources of the subsystems they disable.
+#if defined(CONFIG_FROZEN) && !CONFIG_WEATHER_ENABLED
+#define WEATHER_DISABLED
+#endif
+#if defined(CONFIG_FROZEN) && !CONFIG_HEALTH_ENABLED
+#define HEALTH_DISABLED
+#endif
+#if defined(CONFIG_FROZEN) && !(defined(PBL_COLOR) && CONFIG_RAINBOW_MODE)
+#define RAINBOW_DISABLED
+#endif
+
 typedef enum
 {
     AppKeyMinuteHandColor = 0,
@@ -36,32 +54,95 @@ typedef enum
     AppKeyHealthEnabled,
     AppKeyBatteryDisplayedAt,
     AppKeyQuietTimeVisible,
-    AppKeyAnimationEnabled
+    AppKeyAnimationEnabled,
+    AppKeyStepRingEnabled,
+    AppKeyWeather,
+    AppKeyPalette,
+    AppKeyLocation,
+    AppKeyCapabilities,
+    AppKeyTrace,
+    AppKeyEnergy,
+    AppKeyConfigChecksum
 } AppKey;
 
 typedef enum
 {
     PersistKeyConfig = 0,
-    PersistKeyWeather
+    PersistKeyLegacyWeather,
+    PersistKeyStepAverage,
+    PersistKeyWeather,
+    PersistKeyLocation,
+    // Takes ENERGY_PERSIST_KEYS keys, keep it last.
+    PersistKeyEnergy
 } PersistKey;
 
+#define WEATHER_VERSION 1
+#define PROTOCOL_VERSION 1
+
+// Payloads this build understands on top of the per-key tuples, announced to
+// the phone in AppKeyCapabilities along with the protocol version and inbox
+// size: version << 24 | features << 16 | inbox size.
+typedef enum
+{
+    ProtocolFeaturePackedWeather = 1 << 0,
+    ProtocolFeatureDeltaConfig = 1 << 1,
+    ProtocolFeatureLocation = 1 << 2,
+    ProtocolFeatureTrace = 1 << 3,
+    ProtocolFeatureConfigChecksum = 1 << 4
+} ProtocolFeature;
+
+#define PROTOCOL_FEATURES (ProtocolFeaturePackedWeather | ProtocolFeatureDeltaConfig | ProtocolFeatureLocation | ProtocolFeatureTrace | ProtocolFeatureConfigChecksum)
+
+// AppKeyConfigChecksum is the checksum of the settings in use, flagged when
+// it answers a save. The phone only syncs the settings that changed since the
+// last save, and syncs them all again when the watch holds others, e.g. after
+// it fell back to the defaults.
+#define CONFIG_CHECKSUM_SAVED (1 << 16)
+
+// Both the AppKeyWeather payload and the persisted weather record.
 typedef struct
 {
-    int32_t timestamp;
-    int8_t icon;
+    uint8_t version;
+    uint8_t icon;
     int8_t temperature;
-    int8_t failed;
-} Weather;
+    uint8_t failed;
+    // When the phone fetched it, which expiry is measured from.
+    uint32_t timestamp;
+} __attribute__((packed)) Weather;
+
+typedef struct
+{
+    int32_t day;
+    int32_t hour;
+    int32_t hour_start_steps;
+    int32_t hour_end_steps;
+} StepAverage;
+
+typedef enum
+{
+    WatchStatusBluetooth = 1 << 0,
+    WatchStatusHeart = 1 << 1,
+    WatchStatusBattery = 1 << 2,
+    WatchStatusQuietTime = 1 << 3
+} WatchStatus;
 
 typedef struct
 {
     Config *config;
     Weather weather;
+    Coordinates location;
+    bool location_known;
+    bool daylight;
+    int weather_failures;
     bool reset_weather;
     int steps;
+    StepAverage step_average;
     bool bluetooth_connected;
     BatteryChargeState charge_state;
-    tm *time;
+    uint8_t watch_status;
+    PowerProfile power_profile;
+    bool sleeping;
+    TimeState time;
 } Context;
 
 static Context s_context;
@@ -79,10 +160,16 @@ static TextBlock *s_minute_text;
 
 static Layer *s_tick_layer;
 
-static GBitmap *s_rainbow_bitmap;
+#ifndef HEALTH_DISABLED
+static StepRing *s_step_ring;
+#endif
+
 static Layer *s_minute_hand_layer;
 static Layer *s_hour_hand_layer;
+#ifndef RAINBOW_DISABLED
+static GBitmap *s_rainbow_bitmap;
 static RotBitmapLayer *s_rainbow_hand_layer;
+#endif
 static Layer *s_center_circle_layer;
 
 static Quadrants *s_quadrants;
@@ -97,224 +184,451 @@ static int s_js_ready;
 
 static GFont s_font;
 
-static tm *s_current_time;
-
 static AnimationProgress s_unob_area_anim_progress = ANIMATION_NORMALIZED_MIN;
 
 static void schedule_weather_request(int timeout);
 static void mark_dirty_minute_hand_layer();
 static void fetch_step(Context *const context);
+static void update_step_ring_visibility();
+static void refresh_watch_status();
+static bool rainbow_mode_active();
+static void refresh_sleeping();
+static void update_power_profile();
 
+#ifndef CONFIG_FROZEN
 static const ConfValue CONF_DEFAULTS[CONF_SIZE] = {
-    {.key = ConfigKeyMinuteHandColor, .value = 0xffffff},
-    {.key = ConfigKeyHourHandColor, .value = PBL_IF_COLOR_ELSE(0xff0000, 0xffffff)},
-    {.key = ConfigKeyBackgroundColor, .value = 0x000000},
-    {.key = ConfigKeyDateColor, .value = PBL_IF_COLOR_ELSE(0x555555, 0xffffff)},
-    {.key = ConfigKeyTimeColor, .value = PBL_IF_COLOR_ELSE(0xaaaaaa, 0xffffff)},
-    {.key = ConfigKeyInfoColor, .value = PBL_IF_COLOR_ELSE(0x555555, 0xffffff)},
-    {.key = ConfigKeyBluetoothIcon, .value = CONFIG_BLUETOOTH_ICON},
-    {.key = ConfigKeyTemperatureUnit, .value = CONFIG_TEMPERATURE_UNIT},
-    {.key = ConfigKeyRefreshRate, .value = 20},
-    {.key = ConfigKeyDateDisplayed, .value = CONFIG_DATE_DISPLAYED},
-    {.key = ConfigKeyRainbowMode, .value = PBL_IF_COLOR_ELSE(CONFIG_RAINBOW_MODE, false)},
-    {.key = ConfigKeyWeatherEnabled, .value = CONFIG_WEATHER_ENABLED},
-    {.key = ConfigKeyVibrateOnTheHour, .value = false},
-    {.key = ConfigKeyVersion, .value = CONF_VERSION},
-    {.key = ConfigKeyHealthEnabled, .value = false},
-    {.key = ConfigKeyBatteryDisplayedAt, .value = -1},
-    {.key = ConfigKeyQuietTimeVisible, .value = true},
-    {.key = ConfigKeyAnimationEnabled, .value = true}};
-
-static void update_current_time()
+    {.key = ConfigKeyMinuteHandColor, .type = ColorConf, .value.integer = CONFIG_MINUTE_HAND_COLOR},
+    {.key = ConfigKeyHourHandColor, .type = ColorConf, .value.integer = CONFIG_HOUR_HAND_COLOR},
+    {.key = ConfigKeyBackgroundColor, .type = ColorConf, .value.integer = CONFIG_BACKGROUND_COLOR},
+    {.key = ConfigKeyDateColor, .type = ColorConf, .value.integer = CONFIG_DATE_COLOR},
+    {.key = ConfigKeyTimeColor, .type = ColorConf, .value.integer = CONFIG_TIME_COLOR},
+    {.key = ConfigKeyInfoColor, .type = ColorConf, .value.integer = CONFIG_INFO_COLOR},
+    {.key = ConfigKeyBluetoothIcon, .type = IntConf, .value.integer = CONFIG_BLUETOOTH_ICON},
+    {.key = ConfigKeyTemperatureUnit, .type = IntConf, .value.integer = CONFIG_TEMPERATURE_UNIT},
+    {.key = ConfigKeyRefreshRate, .type = IntConf, .value.integer = CONFIG_REFRESH_RATE},
+    {.key = ConfigKeyDateDisplayed, .type = BoolConf, .value.integer = CONFIG_DATE_DISPLAYED},
+    {.key = ConfigKeyRainbowMode, .type = BoolConf, .value.integer = PBL_IF_COLOR_ELSE(CONFIG_RAINBOW_MODE, false)},
+    {.key = ConfigKeyWeatherEnabled, .type = BoolConf, .value.integer = CONFIG_WEATHER_ENABLED},
+    {.key = ConfigKeyVibrateOnTheHour, .type = BoolConf, .value.integer = CONFIG_VIBRATE_ON_THE_HOUR},
+    {.key = ConfigKeyVersion, .type = IntConf, .value.integer = CONF_VERSION},
+    {.key = ConfigKeyHealthEnabled, .type = BoolConf, .value.integer = CONFIG_HEALTH_ENABLED},
+    {.key = ConfigKeyBatteryDisplayedAt, .type = IntConf, .value.integer = CONFIG_BATTERY_DISPLAYED_AT},
+    {.key = ConfigKeyQuietTimeVisible, .type = BoolConf, .value.integer = CONFIG_QUIET_TIME_VISIBLE},
+    {.key = ConfigKeyAnimationEnabled, .type = BoolConf, .value.integer = CONFIG_ANIMATION_ENABLED},
+    {.key = ConfigKeyStepRingEnabled, .type = BoolConf, .value.integer = CONFIG_STEP_RING_ENABLED}};
+#endif
+
+static void update_current_time(const tm *tick_time)
 {
 #ifdef SCREENSHOT
-    time_t screenshot_time = SCREENSHOT;
-    s_current_time = gmtime(&screenshot_time);
-#else
-    const time_t temp = time(NULL);
-    s_current_time = localtime(&temp);
+    const time_t screenshot_time = SCREENSHOT;
+    tick_time = gmtime(&screenshot_time);
 #endif
-    s_context.time = s_current_time;
+    time_state_update(&s_context.time, tick_time);
 }
 
 // Messenger
 
-static void config_info_color_updated(DictionaryIterator *iter, Tuple *tuple)
+#ifndef CONFIG_FROZEN
+
+// What has to be refreshed on the watch after a config value changed.
+typedef enum
 {
-    config_set_int(s_config, ConfigKeyInfoColor, tuple->value->int32);
-}
+    ConfigEffectNone = 0,
+    ConfigEffectWeather = 1 << 0,
+    ConfigEffectLayout = 1 << 1,
+    ConfigEffectHands = 1 << 2,
+    ConfigEffectLabels = 1 << 3,
+    ConfigEffectColors = 1 << 4,
+    ConfigEffectVisibility = 1 << 5,
+    ConfigEffectStatus = 1 << 6,
+    ConfigEffectSteps = 1 << 7
+} ConfigEffect;
 
-static void config_background_color_updated(DictionaryIterator *iter, Tuple *tuple)
+typedef struct
 {
-    config_set_int(s_config, ConfigKeyBackgroundColor, tuple->value->int32);
-    window_set_background_color(s_main_window, config_get_color(s_config, ConfigKeyBackgroundColor));
+    AppKey app_key;
+    ConfigKey config_key;
+    uint8_t effects;
+} ConfigMessage;
+
+static const ConfigMessage CONFIG_MESSAGES[] = {
+    {AppKeyMinuteHandColor, ConfigKeyMinuteHandColor, ConfigEffectHands},
+    {AppKeyHourHandColor, ConfigKeyHourHandColor, ConfigEffectHands},
+    {AppKeyBackgroundColor, ConfigKeyBackgroundColor, ConfigEffectColors},
+    {AppKeyTimeColor, ConfigKeyTimeColor, ConfigEffectLabels},
+    {AppKeyInfoColor, ConfigKeyInfoColor, ConfigEffectColors | ConfigEffectLabels},
+    {AppKeyDateDisplayed, ConfigKeyDateDisplayed, ConfigEffectVisibility | ConfigEffectLayout},
+    {AppKeyBluetoothIcon, ConfigKeyBluetoothIcon, ConfigEffectStatus},
+    {AppKeyRainbowMode, ConfigKeyRainbowMode, ConfigEffectHands},
+    {AppKeyTemperatureUnit, ConfigKeyTemperatureUnit, ConfigEffectLabels},
+    {AppKeyRefreshRate, ConfigKeyRefreshRate, ConfigEffectNone},
+    {AppKeyWeatherEnabled, ConfigKeyWeatherEnabled, ConfigEffectVisibility | ConfigEffectLayout | ConfigEffectWeather},
+    {AppKeyVibrateOnTheHour, ConfigKeyVibrateOnTheHour, ConfigEffectNone},
+    {AppKeyHealthEnabled, ConfigKeyHealthEnabled, ConfigEffectVisibility | ConfigEffectLayout | ConfigEffectSteps},
+    {AppKeyBatteryDisplayedAt, ConfigKeyBatteryDisplayedAt, ConfigEffectStatus},
+    {AppKeyQuietTimeVisible, ConfigKeyQuietTimeVisible, ConfigEffectStatus},
+    {AppKeyAnimationEnabled, ConfigKeyAnimationEnabled, ConfigEffectNone},
+    {AppKeyStepRingEnabled, ConfigKeyStepRingEnabled, ConfigEffectVisibility | ConfigEffectSteps}};
+
+#define CONFIG_MESSAGES_COUNT (sizeof(CONFIG_MESSAGES) / sizeof(ConfigMessage))
+
+static uint8_t s_config_effects;
+static bool s_config_changed;
+
+static int32_t tuple_int(const Tuple *const tuple)
+{
+    switch (tuple->length)
+    {
+    case 1:
+        return tuple->type == TUPLE_INT ? tuple->value->int8 : tuple->value->uint8;
+    case 2:
+        return tuple->type == TUPLE_INT ? tuple->value->int16 : tuple->value->uint16;
+    default:
+        return tuple->value->int32;
+    }
 }
 
-static void config_time_color_updated(DictionaryIterator *iter, Tuple *tuple)
+static void config_set_changed(const ConfigKey key, const int32_t value, const uint8_t effects)
 {
-    config_set_int(s_config, ConfigKeyTimeColor, tuple->value->int32);
-    layer_mark_dirty(s_tick_layer);
+    if (config_get_int(s_config, key) == value)
+    {
+        return;
+    }
+    config_set_int(s_config, key, value);
+    s_config_changed = true;
+    s_config_effects |= effects;
+}
 
-    text_block_mark_dirty(s_hour_text);
-    text_block_mark_dirty(s_minute_text);
+static void config_value_updated(DictionaryIterator *iter, Tuple *tuple)
+{
+    for (unsigned int i = 0; i < CONFIG_MESSAGES_COUNT; i++)
+    {
+        const ConfigMessage *const message = &CONFIG_MESSAGES[i];
+        if (message->app_key == tuple->key)
+        {
+            config_set_changed(message->config_key, tuple_int(tuple), message->effects);
+            return;
+        }
+    }
 }
 
-static void config_hour_hand_color_updated(DictionaryIterator *iter, Tuple *tuple)
+static void config_palette_updated(DictionaryIterator *iter, Tuple *tuple)
 {
-    config_set_int(s_config, ConfigKeyHourHandColor, tuple->value->int32);
-    layer_mark_dirty(s_hour_hand_layer);
+    static const AppKey PALETTE[] = {
+        AppKeyMinuteHandColor,
+        AppKeyHourHandColor,
+        AppKeyBackgroundColor,
+        AppKeyTimeColor,
+        AppKeyInfoColor};
+    const int count = sizeof(PALETTE) / sizeof(AppKey);
+    for (int i = 0; i < count && i < tuple->length; i++)
+    {
+        for (unsigned int j = 0; j < CONFIG_MESSAGES_COUNT; j++)
+        {
+            const ConfigMessage *const message = &CONFIG_MESSAGES[j];
+            if (message->app_key == PALETTE[i])
+            {
+                config_set_changed(message->config_key, config_hex_from_gcolor8(tuple->value->data[i]), message->effects);
+            }
+        }
+    }
 }
 
-static void config_minute_hand_color_updated(DictionaryIterator *iter, Tuple *tuple)
+static void apply_config_effects(const uint8_t effects)
 {
-    config_set_int(s_config, ConfigKeyMinuteHandColor, tuple->value->int32);
-    mark_dirty_minute_hand_layer();
+    if (effects & ConfigEffectVisibility)
+    {
+        text_block_set_enabled(s_date_info, config_get_bool(s_config, ConfigKeyDateDisplayed));
+        text_block_set_enabled(s_weather_info, config_get_bool(s_config, ConfigKeyWeatherEnabled));
+        text_block_set_enabled(s_steps_info, config_get_bool(s_config, ConfigKeyHealthEnabled));
+        update_step_ring_visibility();
+    }
+    if (effects & ConfigEffectSteps)
+    {
+        refresh_sleeping();
+        update_power_profile();
+        fetch_step(&s_context);
+        text_block_mark_dirty(s_steps_info);
+    }
+    if (effects & ConfigEffectStatus)
+    {
+        refresh_watch_status();
+    }
+    if (effects & ConfigEffectColors)
+    {
+        window_set_background_color(s_main_window, config_get_color(s_config, ConfigKeyBackgroundColor));
+        step_ring_set_color(s_step_ring, config_get_color(s_config, ConfigKeyInfoColor));
+        layer_mark_dirty(s_root_layer);
+    }
+    if (effects & ConfigEffectHands)
+    {
+        mark_dirty_minute_hand_layer();
+        layer_mark_dirty(s_hour_hand_layer);
+        layer_mark_dirty(s_center_circle_layer);
+    }
+    if (effects & ConfigEffectLabels)
+    {
+        layer_mark_dirty(s_tick_layer);
+        text_block_mark_dirty(s_hour_text);
+        text_block_mark_dirty(s_minute_text);
+        text_block_mark_dirty(s_date_info);
+        text_block_mark_dirty(s_steps_info);
+        text_block_mark_dirty(s_weather_info);
+        text_block_mark_dirty(s_watch_info);
+    }
+    if (effects & ConfigEffectWeather)
+    {
+        s_context.reset_weather = true;
+        schedule_weather_request(NOW);
+    }
+    if (effects & ConfigEffectLayout)
+    {
+        quadrants_update(s_quadrants, &s_context.time);
+    }
 }
 
-static void config_refresh_rate_updated(DictionaryIterator *iter, Tuple *tuple)
+#endif
+
+static void js_ready_callback(DictionaryIterator *iter, Tuple *tuple)
 {
-    config_set_int(s_config, ConfigKeyRefreshRate, tuple->value->int32);
+    s_js_ready = true;
+    const int32_t capabilities = PROTOCOL_VERSION << 24 | PROTOCOL_FEATURES << 16 | MESSENGER_INBOX_SIZE;
+    messenger_send(s_messenger, AppKeyCapabilities, capabilities);
+#ifndef CONFIG_FROZEN
+    messenger_send(s_messenger, AppKeyConfigChecksum, config_checksum(s_config));
+#endif
+    schedule_weather_request(NOW);
 }
 
-static void config_temperature_unit_updated(DictionaryIterator *iter, Tuple *tuple)
+static void weather_updated()
 {
-    config_set_int(s_config, ConfigKeyTemperatureUnit, tuple->value->int32);
+    s_context.weather.version = WEATHER_VERSION;
+    energy_count_persist(persist_write_data(PersistKeyWeather, &s_context.weather, sizeof(Weather)));
     text_block_mark_dirty(s_weather_info);
+    quadrants_update(s_quadrants, &s_context.time);
 }
 
-static void config_bluetooth_icon_updated(DictionaryIterator *iter, Tuple *tuple)
+#ifndef WEATHER_DISABLED
+
+static void weather_callback(DictionaryIterator *iter, Tuple *tuple)
 {
-    config_set_int(s_config, ConfigKeyBluetoothIcon, tuple->value->int32);
-    text_block_mark_dirty(s_watch_info);
+    Weather weather;
+    if (tuple->type != TUPLE_BYTE_ARRAY || tuple->length != sizeof(Weather))
+    {
+        return;
+    }
+    memcpy(&weather, tuple->value->data, sizeof(Weather));
+    if (weather.version != WEATHER_VERSION)
+    {
+        return;
+    }
+    const uint32_t now = time(NULL);
+    if (weather.timestamp > now)
+    {
+        weather.timestamp = now;
+    }
+    s_context.reset_weather = false;
+    s_context.weather_failures = weather.failed ? s_context.weather_failures + 1 : 0;
+    s_context.weather = weather;
+    weather_updated();
 }
 
-static void config_battery_displayed_at_updated(DictionaryIterator *iter, Tuple *tuple)
+static void location_callback(DictionaryIterator *iter, Tuple *tuple)
 {
-    config_set_int(s_config, ConfigKeyBatteryDisplayedAt, tuple->value->int32);
-    text_block_mark_dirty(s_watch_info);
+    if (tuple->type != TUPLE_BYTE_ARRAY || tuple->length != sizeof(Coordinates))
+    {
+        return;
+    }
+    memcpy(&s_context.location, tuple->value->data, sizeof(Coordinates));
+    s_context.location_known = true;
+    energy_count_persist(persist_write_data(PersistKeyLocation, &s_context.location, sizeof(Coordinates)));
+    s_context.daylight = solar_is_day(&s_context.location, time(NULL));
+    text_block_mark_dirty(s_weather_info);
 }
 
-static void config_date_displayed_updated(DictionaryIterator *iter, Tuple *tuple)
+static void weather_requested_callback(DictionaryIterator *iter, Tuple *tuple)
 {
-    config_set_bool(s_config, ConfigKeyDateDisplayed, tuple->value->int8);
-    text_block_set_enabled(s_date_info, tuple->value->int8);
-    text_block_mark_dirty(s_date_info);
+    s_context.reset_weather = false;
+    s_context.weather_failures = 0;
+    const Tuple *const icon_tuple = dict_find(iter, AppKeyWeatherIcon);
+    const Tuple *const temp_tuple = dict_find(iter, AppKeyWeatherTemperature);
+    if (icon_tuple && temp_tuple)
+    {
+        s_context.weather.failed = false;
+        s_context.weather.timestamp = time(NULL);
+        s_context.weather.icon = icon_tuple->value->int8;
+        s_context.weather.temperature = temp_tuple->value->int8;
+    }
+    weather_updated();
 }
 
-static void config_rainbow_mode_updated(DictionaryIterator *iter, Tuple *tuple)
+#endif
+
+static void weather_failed()
 {
-    config_set_bool(s_config, ConfigKeyRainbowMode, tuple->value->int8);
-    mark_dirty_minute_hand_layer();
+    s_context.weather.failed = true;
+    s_context.weather.timestamp = time(NULL);
+    s_context.weather_failures++;
+    weather_updated();
 }
 
-static void config_weather_enabled_updated(DictionaryIterator *iter, Tuple *tuple)
+#ifndef WEATHER_DISABLED
+static void weather_request_failed_callback(DictionaryIterator *iter, Tuple *tuple)
 {
-    const bool enabled = tuple->value->int8;
-    config_set_bool(s_config, ConfigKeyWeatherEnabled, enabled);
-    text_block_set_enabled(s_weather_info, enabled);
+    weather_failed();
 }
+#endif
+
+// Trace
+
+// A dump goes out one AppKeyTrace chunk at a time, the next one once the
+// previous one was delivered. The phone writes them to its log.
+static int s_trace_chunk = -1;
 
-static void config_hourly_vibrate_updated(DictionaryIterator *iter, Tuple *tuple)
+static void trace_send_chunk()
 {
-    config_set_bool(s_config, ConfigKeyVibrateOnTheHour, tuple->value->int8);
+    uint8_t buffer[TRACE_CHUNK_SIZE];
+    const uint16_t size = trace_read_chunk(s_trace_chunk, buffer);
+    if (size == 0 || !messenger_send_data(s_messenger, AppKeyTrace, buffer, size))
+    {
+        s_trace_chunk = -1;
+        trace_set_paused(false);
+    }
 }
 
-static void config_health_enabled_updated(DictionaryIterator *iter, Tuple *tuple)
+static void trace_requested_callback(DictionaryIterator *iter, Tuple *tuple)
 {
-    const bool enabled = tuple->value->int8;
-    config_set_bool(s_config, ConfigKeyHealthEnabled, enabled);
-    if (enabled)
+    if (s_trace_chunk >= 0)
     {
-        fetch_step(&s_context);
+        return;
     }
-    text_block_set_enabled(s_steps_info, enabled);
+    trace_set_paused(true);
+    s_trace_chunk = 0;
+    trace_send_chunk();
 }
 
-static void config_quiet_time_visible_updated(DictionaryIterator *iter, Tuple *tuple)
+static void trace_sent(const bool delivered)
 {
-    config_set_bool(s_config, ConfigKeyQuietTimeVisible, tuple->value->int8);
-    text_block_mark_dirty(s_watch_info);
+    if (!delivered)
+    {
+        s_trace_chunk = -1;
+        trace_set_paused(false);
+        return;
+    }
+    s_trace_chunk++;
+    trace_send_chunk();
 }
 
-static void config_animation_enabled(DictionaryIterator *iter, Tuple *tuple)
+// Energy
+
+// The counts of a finished day go to the phone, which turns them into an
+// estimated cost per subsystem.
+static void energy_report(const uint8_t *data, const uint16_t size)
 {
-    config_set_bool(s_config, ConfigKeyAnimationEnabled, tuple->value->int8);
+    messenger_send_data(s_messenger, AppKeyEnergy, data, size);
 }
 
-static void js_ready_callback(DictionaryIterator *iter, Tuple *tuple)
+#ifdef BENCHMARK
+// The simulated clock of benchmarks, see benchmark_tick_callback().
+static time_t s_benchmark_time = BENCHMARK;
+#endif
+
+// The local midnight and the hour that counts go to. Benchmarks count against
+// their simulated clock, so that their days roll over at simulated midnight.
+static int32_t energy_today(int *const hour)
 {
-    s_js_ready = true;
-    schedule_weather_request(NOW);
+#ifdef BENCHMARK
+    *hour = gmtime(&s_benchmark_time)->tm_hour;
+    return s_benchmark_time - s_benchmark_time % (24 * 60 * 60);
+#else
+    const time_t now = time(NULL);
+    *hour = localtime(&now)->tm_hour;
+    return time_start_of_today();
+#endif
 }
 
-static void weather_requested_callback(DictionaryIterator *iter, Tuple *tuple)
+// Each hour keeps the settings of its last tick, for the phone to tell the
+// costs of different settings apart.
+static void note_energy_settings()
 {
-    s_context.reset_weather = false;
-    const Tuple *const icon_tuple = dict_find(iter, AppKeyWeatherIcon);
-    const Tuple *const temp_tuple = dict_find(iter, AppKeyWeatherTemperature);
-    if (icon_tuple && temp_tuple)
-    {
-        s_context.weather.failed = false;
-        s_context.weather.timestamp = time(NULL);
-        s_context.weather.icon = icon_tuple->value->int8;
-        s_context.weather.temperature = temp_tuple->value->int8;
-    }
-    persist_write_data(PersistKeyWeather, &s_context.weather, sizeof(Weather));
-    text_block_mark_dirty(s_weather_info);
-    quadrants_update(s_quadrants, s_current_time);
+    const uint8_t flags = s_context.power_profile |
+                          (rainbow_mode_active() ? EnergySettingsRainbow : 0) |
+                          (config_get_bool(s_config, ConfigKeyWeatherEnabled) ? EnergySettingsWeather : 0) |
+                          (config_get_bool(s_config, ConfigKeyHealthEnabled) ? EnergySettingsHealth : 0);
+    energy_note_settings(config_get_int(s_config, ConfigKeyRefreshRate), flags);
 }
 
-static void weather_request_failed_callback(DictionaryIterator *iter, Tuple *tuple)
+static void outbox_callback(const uint32_t key, const bool delivered)
 {
-    s_context.weather.failed = true;
-    s_context.weather.timestamp = time(NULL);
-    persist_write_data(PersistKeyWeather, &s_context.weather, sizeof(Weather));
-    text_block_mark_dirty(s_weather_info);
-    quadrants_update(s_quadrants, s_current_time);
+    if (key == AppKeyWeatherRequest && !delivered)
+    {
+        weather_failed();
+    }
+    else if (key == AppKeyTrace && s_trace_chunk >= 0)
+    {
+        trace_sent(delivered);
+    }
 }
 
+#ifndef CONFIG_FROZEN
+// Each message is applied with a single batch of redraws: the union of the
+// effects of the values that actually changed. Changed values are persisted
+// with the message that carries them, so that a save split across messages
+// keeps its applied part when the last one, with AppKeyConfig, is lost. A save
+// without any watch side change means only phone side settings changed, which
+// is the weather location.
 static void messenger_callback(DictionaryIterator *iter)
 {
-    if (dict_find(iter, AppKeyConfig))
+    const bool config_saved = dict_find(iter, AppKeyConfig) != NULL;
+    if (config_saved && !s_config_changed)
+    {
+        s_config_effects |= ConfigEffectWeather;
+    }
+    apply_config_effects(s_config_effects);
+    if (s_config_changed)
     {
         config_set_int(s_config, ConfigKeyVersion, CONF_VERSION);
-        config_save(s_config, PersistKeyConfig);
+        energy_count_persist(config_save(s_config, PersistKeyConfig));
+        s_config_changed = false;
+    }
+    if (config_saved)
+    {
+        // The acknowledgement of the save must not be replaced by a plain
+        // checksum sent before it goes out.
+        messenger_send_once(s_messenger, AppKeyConfigChecksum, CONFIG_CHECKSUM_SAVED | config_checksum(s_config));
+    }
+    s_config_effects = ConfigEffectNone;
+}
+#else
+// Settings cannot change, a save only means a new weather location.
+static void messenger_callback(DictionaryIterator *iter)
+{
+    if (config_get_bool(s_config, ConfigKeyWeatherEnabled) && dict_find(iter, AppKeyConfig))
+    {
         s_context.reset_weather = true;
         schedule_weather_request(NOW);
-        quadrants_update(s_quadrants, s_current_time);
-        layer_mark_dirty(s_root_layer);
     }
 }
+#endif
 
 // Time
 
-static bool times_conflicting(const tm *const time)
-{
-    return time->tm_hour % 12 == time->tm_min / 5;
-}
-
-static bool times_conflicting_north_or_south(const tm *const time)
-{
-    if (!times_conflicting(time))
-        return false;
-    const int hour_mod_12 = time->tm_hour % 12;
-    return hour_mod_12 <= 1 || hour_mod_12 >= 11 || (hour_mod_12 >= 5 && hour_mod_12 <= 7);
-}
-
 static void hour_time_update_proc(TextBlock *block)
 {
     const Context *const context = (Context *)text_block_get_context(block);
     const GColor color = config_get_color(s_config, ConfigKeyTimeColor);
     char buffer[] = "00:00";
-    const int hour = context->time->tm_hour;
-    const int hour_mod_12 = hour % 12;
+    const TimeState *const time = &context->time;
+    const int hour = time->local.tm_hour;
+    const int hour_mod_12 = time->hour_mod_12;
     const GPoint block_center = get_time_position(hour_mod_12, s_unob_area_anim_progress);
     const bool military_time = clock_is_24h_style();
     const int printed_hour = military_time ? hour : hour_mod_12 == 0 ? 12
                                                                      : hour_mod_12;
-    if (times_conflicting_north_or_south(context->time))
+    if (time->conflicting_north_or_south)
     {
-        const int min = context->time->tm_min;
+        const int min = time->local.tm_min;
         snprintf(buffer, sizeof(buffer), "%d:%02d", printed_hour, min);
         text_block_set_text(block, buffer, color);
         text_block_move(block, block_center);
@@ -323,7 +637,7 @@ static void hour_time_update_proc(TextBlock *block)
     {
         snprintf(buffer, sizeof(buffer), "%d", printed_hour);
         text_block_set_text(block, buffer, color);
-        if (times_conflicting(context->time))
+        if (time->conflicting)
         {
             text_block_move(block, GPoint(block_center.x, block_center.y - TIME_CONFLICT_OFFSET));
         }
@@ -340,9 +654,10 @@ static void minute_time_update_proc(TextBlock *block)
     const Config *const config = context->config;
     const GColor color = config_get_color(config, ConfigKeyTimeColor);
     char buffer[] = "00";
-    const int min = context->time->tm_min;
-    const GPoint block_center = get_time_position(min / 5, s_unob_area_anim_progress);
-    if (times_conflicting_north_or_south(context->time))
+    const TimeState *const time = &context->time;
+    const int min = time->local.tm_min;
+    const GPoint block_center = get_time_position(time->minute_tick, s_unob_area_anim_progress);
+    if (time->conflicting_north_or_south)
     {
         text_block_set_text(s_minute_text, "", color);
     }
@@ -350,7 +665,7 @@ static void minute_time_update_proc(TextBlock *block)
     {
         text_block_set_enabled(s_minute_text, true);
         snprintf(buffer, sizeof(buffer), "%02d", min);
-        if (times_conflicting(context->time))
+        if (time->conflicting)
         {
             text_block_move(s_minute_text, GPoint(block_center.x, block_center.y + TIME_CONFLICT_OFFSET));
         }
@@ -372,7 +687,7 @@ static void date_info_update_proc(TextBlock *block)
     {
         const GColor date_color = config_get_color(config, ConfigKeyInfoColor);
         char buffer[] = "00";
-        snprintf(buffer, sizeof(buffer), "%d", context->time->tm_mday);
+        snprintf(buffer, sizeof(buffer), "%d", context->time.local.tm_mday);
         text_block_set_text(block, buffer, date_color);
     }
 }
@@ -383,46 +698,64 @@ static AnimationProgress s_animation_progress;
 static void mark_dirty_minute_hand_layer()
 {
     layer_mark_dirty(s_minute_hand_layer);
-    const bool rainbow_mode = config_get_bool(s_config, ConfigKeyRainbowMode);
+#ifndef RAINBOW_DISABLED
+    const bool rainbow_mode = rainbow_mode_active();
+    // The rotated bitmap is the only minute hand in rainbow mode, it follows
+    // the minutes in every power profile.
     if (rainbow_mode)
     {
-        const int minute_angle = angle_minute(s_current_time);
-        rot_bitmap_layer_set_angle(s_rainbow_hand_layer, minute_angle);
+        rot_bitmap_layer_set_angle(s_rainbow_hand_layer, s_context.time.minute_angle);
     }
     layer_set_hidden((Layer *)s_rainbow_hand_layer, !rainbow_mode);
+#endif
 }
 
 static void update_minute_hand_layer(Layer *layer, GContext *ctx)
 {
-    if (!config_get_bool(s_config, ConfigKeyRainbowMode))
+    if (rainbow_mode_active())
+    {
+        // The rotated bitmap is drawn by its own layer, over the whole hand.
+        energy_count(EnergyRedrawRainbow, 1);
+    }
+    else
     {
         const int start_angle = angle(270, 360);
-        const int minute_angle = angle_minute(s_current_time);
-        const int hand_angle = minute_angle - start_angle * (ANIMATION_NORMALIZED_MAX - s_animation_progress) / (ANIMATION_NORMALIZED_MAX + 1);
+        const int hand_angle = s_context.time.minute_angle - start_angle * (ANIMATION_NORMALIZED_MAX - s_animation_progress) / (ANIMATION_NORMALIZED_MAX + 1);
         const GPoint hand_end = gpoint_on_circle(g_center, hand_angle, MINUTE_HAND_RADIUS);
         graphics_context_set_stroke_width(ctx, MINUTE_HAND_WIDTH);
         graphics_context_set_stroke_color(ctx, config_get_color(s_config, ConfigKeyMinuteHandColor));
         graphics_draw_line(ctx, g_center, hand_end);
+        energy_count(EnergyRedrawHands, 1);
+        energy_count(EnergyDrawCalls, 1);
     }
 }
 
 static void update_hour_hand_layer(Layer *layer, GContext *ctx)
 {
-    const int hour_angle = angle_hour(s_current_time, true);
+    const int hour_angle = s_context.time.hour_angle;
     const int start_angle = angle(90, 360);
-    const bool rainbow_mode = config_get_bool(s_config, ConfigKeyRainbowMode);
+    const bool rainbow_mode = rainbow_mode_active();
     const int hand_angle = rainbow_mode ? hour_angle : hour_angle - start_angle * (ANIMATION_NORMALIZED_MAX - s_animation_progress) / (ANIMATION_NORMALIZED_MAX + 1);
     const GPoint hand_end = gpoint_on_circle(g_center, hand_angle, HOUR_HAND_RADIUS);
     graphics_context_set_stroke_width(ctx, HOUR_HAND_WIDTH);
     graphics_context_set_stroke_color(ctx, config_get_color(s_config, ConfigKeyHourHandColor));
     graphics_draw_line(ctx, g_center, hand_end);
+    energy_count(EnergyRedrawHands, 1);
+    energy_count(EnergyDrawCalls, 1);
 }
 
 static void update_center_circle_layer(Layer *layer, GContext *ctx)
 {
-    const GColor color = config_get_bool(s_config, ConfigKeyRainbowMode) ? GColorVividViolet : config_get_color(s_config, ConfigKeyHourHandColor);
+    const GColor color = rainbow_mode_active() ? GColorVividViolet : config_get_color(s_config, ConfigKeyHourHandColor);
     graphics_context_set_fill_color(ctx, color);
     graphics_fill_circle(ctx, g_center, CENTER_CIRCLE_RADIUS);
+    trace_draw_end();
+    // Like the trace, the frame ends here. The whole window is redrawn and
+    // sent to the display, whichever layers were marked dirty.
+    const GRect bounds = layer_get_bounds(window_get_root_layer(s_main_window));
+    energy_count(EnergyFrames, 1);
+    energy_count(EnergyDrawCalls, 1);
+    energy_count_pixels(bounds.size.w * bounds.size.h);
 }
 
 // Ticks
@@ -432,6 +765,7 @@ static void draw_tick(GContext *ctx, const int index)
     GPoint points[2]; 
     get_tick_positions(index, s_unob_area_anim_progress, points);
     graphics_draw_line(ctx, points[0], points[1]);
+    energy_count(EnergyDrawCalls, 1);
 }
 
 static void tick_layer_update_callback(Layer *layer, GContext *graphic_ctx)
@@ -439,25 +773,68 @@ static void tick_layer_update_callback(Layer *layer, GContext *graphic_ctx)
     const Context *const context = *(Context **)layer_get_data(layer);
     graphics_context_set_stroke_color(graphic_ctx, config_get_color(context->config, ConfigKeyTimeColor));
     graphics_context_set_stroke_width(graphic_ctx, TICK_WIDTH);
-    const tm *const time = context->time;
-    draw_tick(graphic_ctx, time->tm_hour % 12);
-    if (times_conflicting(time))
+    const TimeState *const time = &context->time;
+    energy_count(EnergyRedrawTicks, 1);
+    draw_tick(graphic_ctx, time->hour_mod_12);
+    if (time->conflicting)
     {
         return;
     }
-    draw_tick(graphic_ctx, time->tm_min / 5);
+    draw_tick(graphic_ctx, time->minute_tick);
 }
 
 // Weather
 
 #define FAILED_TIMEOUT 2*60
+#define FAILED_TIMEOUT_MAX_SHIFT 5
 #define WEATHER_VISIBLE_TOLERANCE 5*60
 
+// The refresh rate of the current power profile, in seconds.
+static time_t refresh_interval(const Context *const context)
+{
+    const int refresh_rate_factor = power_policy(context->power_profile)->refresh_rate_factor;
+    return config_get_int(context->config, ConfigKeyRefreshRate) * refresh_rate_factor * 60;
+}
+
 static time_t weather_timeout(const Context *const context)
 {
     const Weather *const weather = &(context->weather);
-    const Config *const config = context->config;
-    return (weather->failed ? FAILED_TIMEOUT : (config_get_int(config, ConfigKeyRefreshRate)) * 60);
+    const time_t refresh_timeout = refresh_interval(context);
+    if (!weather->failed)
+    {
+        return refresh_timeout;
+    }
+    // Consecutive failures back off exponentially, up to the refresh rate.
+    const int shift = context->weather_failures > 1 ? context->weather_failures - 1 : 0;
+    const time_t failed_timeout = FAILED_TIMEOUT << (shift < FAILED_TIMEOUT_MAX_SHIFT ? shift : FAILED_TIMEOUT_MAX_SHIFT);
+    return failed_timeout < refresh_timeout ? failed_timeout : refresh_timeout;
+}
+
+// The phone picks the icon for when the weather was observed, the watch
+// switches it between day and night as the sun rises and sets.
+static char weather_icon(const Context *const context)
+{
+    const char icon = context->weather.icon;
+    if (!context->location_known || icon < 'A' || (icon > 'Z' && icon < 'a') || icon > 'z')
+    {
+        return icon;
+    }
+    const char day_icon = icon | 0x20;
+    return context->daylight ? day_icon : day_icon & ~0x20;
+}
+
+static void refresh_daylight()
+{
+    if (!s_context.location_known)
+    {
+        return;
+    }
+    const bool daylight = solar_is_day(&s_context.location, time(NULL));
+    if (daylight != s_context.daylight)
+    {
+        s_context.daylight = daylight;
+        text_block_mark_dirty(s_weather_info);
+    }
 }
 
 static void weather_info_update_proc(TextBlock *block)
@@ -468,13 +845,13 @@ static void weather_info_update_proc(TextBlock *block)
     const int timeout = weather_timeout(context);
     const int expiration = weather->timestamp + timeout + WEATHER_VISIBLE_TOLERANCE;
     const bool weather_valid = time(NULL) < expiration;
-    char info_buffer[6] = {0};
+    char info_buffer[16] = {0};
     if (weather_valid && !weather->failed)
     {
         const int temp = weather->temperature;
         const bool is_farhrenheit = config_get_int(config, ConfigKeyTemperatureUnit) == Fahrenheit;
         const int converted_temp = is_farhrenheit ? (temp * 9 + 2) / 5 + 32 : temp;
-        snprintf(info_buffer, 6, "%c%d°", weather->icon, converted_temp);
+        snprintf(info_buffer, sizeof(info_buffer), "%c%d°", weather_icon(context), converted_temp);
     }
     else if (weather->failed)
     {
@@ -484,11 +861,10 @@ static void weather_info_update_proc(TextBlock *block)
     text_block_set_text(block, info_buffer, info_color);
 }
 
-#define WEATHER_TIMEOUT 5000
-
 static void send_weather_request_callback(void *context)
 {
     s_weather_request_timer = NULL;
+    energy_count(EnergyTimerWakeups, 1);
     const int timeout = weather_timeout(&s_context);
     const int expiration = s_context.weather.timestamp + timeout;
     const bool almost_expired = time(NULL) > expiration;
@@ -497,22 +873,8 @@ static void send_weather_request_callback(void *context)
     {
         if (config_get_bool(s_config, ConfigKeyWeatherEnabled))
         {
-            DictionaryIterator *out_iter;
-            AppMessageResult result = app_message_outbox_begin(&out_iter);
-            if (result == APP_MSG_OK)
-            {
-                const int value = 1;
-                dict_write_int(out_iter, AppKeyWeatherRequest, &value, sizeof(int), true);
-                result = app_message_outbox_send();
-                if (result != APP_MSG_OK)
-                {
-                    schedule_weather_request(WEATHER_TIMEOUT);
-                }
-            }
-            else
-            {
-                schedule_weather_request(WEATHER_TIMEOUT);
-            }
+            // The phone only serves cached weather that stays valid that long.
+            messenger_send(s_messenger, AppKeyWeatherRequest, refresh_interval(&s_context));
         }
     }
 }
@@ -537,27 +899,53 @@ static void schedule_weather_request(const int timeout)
 
 // Battery + Bluetooth + Quiet Time
 
+static uint8_t compute_watch_status(const Context *const context)
+{
+    const Config *const config = context->config;
+    uint8_t status = 0;
+    if (!context->bluetooth_connected)
+    {
+        const BluetoothIcon bluetooth_icon = config_get_int(config, ConfigKeyBluetoothIcon);
+        if (bluetooth_icon == Bluetooth)
+        {
+            status |= WatchStatusBluetooth;
+        }
+        else if (bluetooth_icon == Heart)
+        {
+            status |= WatchStatusHeart;
+        }
+    }
+    if (context->charge_state.charge_percent < config_get_int(config, ConfigKeyBatteryDisplayedAt))
+    {
+        status |= WatchStatusBattery;
+    }
+    if (quiet_time_is_active() && config_get_bool(config, ConfigKeyQuietTimeVisible))
+    {
+        status |= WatchStatusQuietTime;
+    }
+    return status;
+}
+
 static void watch_info_update_proc(TextBlock *block)
 {
     const Context *const context = (Context *)text_block_get_context(block);
     const Config *const config = context->config;
+    const uint8_t status = context->watch_status;
     char info_buffer[4] = {0};
     int buf_pos = 0;
-    const BluetoothIcon bluetooth_icon = config_get_int(config, ConfigKeyBluetoothIcon);
-    const bool bluetooth_disconneted = !context->bluetooth_connected;
-    const bool bluetooth_icon_set = bluetooth_icon != NoIcon;
-    if (bluetooth_disconneted && bluetooth_icon_set)
+    if (status & WatchStatusBluetooth)
     {
-        info_buffer[buf_pos++] = bluetooth_icon == Bluetooth ? 'z' : 'Z';
+        info_buffer[buf_pos++] = 'z';
     }
-    const int battery_threshold = config_get_int(config, ConfigKeyBatteryDisplayedAt);
-    const BatteryChargeState charge_state = context->charge_state;
-    const bool battery_below_threshold = charge_state.charge_percent < battery_threshold;
-    if (battery_below_threshold)
+    else if (status & WatchStatusHeart)
+    {
+        info_buffer[buf_pos++] = 'Z';
+    }
+    if (status & WatchStatusBattery)
     {
         info_buffer[buf_pos++] = 'w';
     }
-    if (quiet_time_is_active() && config_get_bool(config, ConfigKeyQuietTimeVisible))
+    if (status & WatchStatusQuietTime)
     {
         info_buffer[buf_pos++] = 'q';
     }
@@ -566,6 +954,19 @@ static void watch_info_update_proc(TextBlock *block)
     text_block_set_text(block, info_buffer, info_color);
 }
 
+// Only a change of the visible icons invalidates the block and the layout.
+static void refresh_watch_status()
+{
+    const uint8_t status = compute_watch_status(&s_context);
+    if (status == s_context.watch_status)
+    {
+        return;
+    }
+    s_context.watch_status = status;
+    text_block_set_enabled(s_watch_info, status != 0);
+    quadrants_update(s_quadrants, &s_context.time);
+}
+
 // Steps
 
 static void steps_info_update_proc(TextBlock *block)
@@ -573,7 +974,7 @@ static void steps_info_update_proc(TextBlock *block)
     const Context *const context = (Context *)text_block_get_context(block);
     const Config *const config = context->config;
     const int steps = context->steps;
-    char step_text[8] = {0};
+    char step_text[16] = {0};
     const GColor info_color = config_get_color(config, ConfigKeyInfoColor);
     if (steps > 10000)
     {
@@ -590,43 +991,169 @@ static void steps_info_update_proc(TextBlock *block)
     text_block_set_text(block, step_text, info_color);
 }
 
+#ifndef HEALTH_DISABLED
+
+static bool step_ring_enabled(const Config *const config)
+{
+    return config_get_bool(config, ConfigKeyHealthEnabled) && config_get_bool(config, ConfigKeyStepRingEnabled);
+}
+
+static void update_step_ring_visibility()
+{
+    step_ring_set_visible(s_step_ring, step_ring_enabled(s_config));
+}
+
+#define SECONDS_PER_HOUR 3600
+
+// health_service_sum_averaged is expensive, so the typical step count at the
+// start and at the end of the current hour is only computed once per hour and
+// kept in persistent storage across relaunches.
+static void fetch_step_average(Context *const context)
+{
+    StepAverage *const average = &context->step_average;
+    const int32_t today = time_start_of_today();
+    const int32_t hour = context->time.local.tm_hour;
+    if (average->day == today && average->hour == hour)
+    {
+        return;
+    }
+    const bool previous_hour_cached = average->day == today && average->hour == hour - 1;
+    average->hour_start_steps = previous_hour_cached ? average->hour_end_steps
+                                                     : health_service_sum_averaged(HealthMetricStepCount, today, today + hour * SECONDS_PER_HOUR, HealthServiceTimeScopeDailyWeekdayOrWeekend);
+    average->hour_end_steps = health_service_sum_averaged(HealthMetricStepCount, today, today + (hour + 1) * SECONDS_PER_HOUR, HealthServiceTimeScopeDailyWeekdayOrWeekend);
+    energy_count(EnergyHealthCalls, previous_hour_cached ? 1 : 2);
+    average->day = today;
+    average->hour = hour;
+    energy_count_persist(persist_write_data(PersistKeyStepAverage, average, sizeof(StepAverage)));
+}
+
+static int typical_steps_now(const Context *const context)
+{
+    const StepAverage *const average = &context->step_average;
+    const int hour_steps = average->hour_end_steps - average->hour_start_steps;
+    return average->hour_start_steps + hour_steps * context->time.local.tm_min / 60;
+}
+
 static void fetch_step(Context *const context)
 {
-    if (config_get_bool(context->config, ConfigKeyHealthEnabled))
+    if (config_get_bool(context->config, ConfigKeyHealthEnabled) && power_policy(context->power_profile)->steps)
     {
         context->steps = (int)health_service_sum_today(HealthMetricStepCount);
+        energy_count(EnergyHealthCalls, 1);
+        if (config_get_bool(context->config, ConfigKeyStepRingEnabled))
+        {
+            fetch_step_average(context);
+            step_ring_set_progress(s_step_ring, context->steps, typical_steps_now(context));
+        }
+    }
+}
+
+#else
+
+static void update_step_ring_visibility()
+{
+}
+
+static void fetch_step(Context *const context)
+{
+}
+
+#endif
+
+// Power
+
+static bool rainbow_mode_active()
+{
+    return config_get_bool(s_config, ConfigKeyRainbowMode);
+}
+
+// Without health, sleep is never detected. Health is only asked at launch and
+// when it reports a change, the profile is picked from the last answer.
+static void refresh_sleeping()
+{
+    s_context.sleeping = false;
+    if (config_get_bool(s_config, ConfigKeyHealthEnabled))
+    {
+        energy_count(EnergyHealthCalls, 1);
+        s_context.sleeping = health_service_peek_current_activities() & (HealthActivitySleep | HealthActivityRestfulSleep);
     }
 }
 
+static void update_power_profile()
+{
+    s_context.power_profile = power_profile_select(s_context.charge_state, s_context.sleeping, quiet_time_is_active());
+}
+
 // Event handlers
 
-static void update_watch_info_layer_visibility()
+// A flaky link can flap many times a minute: disconnections are only shown
+// after a hold time and reconnections trigger at most one weather refresh per
+// interval.
+#define BT_DISCONNECT_HOLD 15000
+#define BT_RECONNECT_WEATHER_INTERVAL (10 * 60)
+
+typedef struct
 {
-    const Config *const config = s_context.config;
-    const bool battery_icon_visible = s_context.charge_state.charge_percent < config_get_int(config, ConfigKeyBatteryDisplayedAt);
-    const bool bt_icon_visible = !s_context.bluetooth_connected && config_get_int(config, ConfigKeyBluetoothIcon) != NoIcon;
-    const bool quiet_time_visible = quiet_time_is_active() && config_get_bool(config, ConfigKeyQuietTimeVisible);
-    text_block_set_enabled(s_watch_info, battery_icon_visible || bt_icon_visible || quiet_time_visible);
+    uint16_t suppressed_disconnects;
+    uint16_t suppressed_weather_requests;
+} ConnectionStats;
+
+static ConnectionStats s_connection_stats;
+static AppTimer *s_bt_disconnect_timer;
+static time_t s_bt_reconnect_weather_request;
+
+static void bt_disconnect_hold_callback(void *data)
+{
+    s_bt_disconnect_timer = NULL;
+    energy_count(EnergyTimerWakeups, 1);
+    s_context.bluetooth_connected = false;
+    refresh_watch_status();
+}
+
+static void bt_reconnected()
+{
+    const time_t now = time(NULL);
+    if (now - s_bt_reconnect_weather_request < BT_RECONNECT_WEATHER_INTERVAL)
+    {
+        s_connection_stats.suppressed_weather_requests++;
+        return;
+    }
+    i("bt reconnected, suppressed %d disconnects and %d weather requests so far",
+      s_connection_stats.suppressed_disconnects, s_connection_stats.suppressed_weather_requests);
+    s_bt_reconnect_weather_request = now;
+    schedule_weather_request(NOW);
 }
 
 static void bt_handler(bool connected)
 {
+    trace_record(TraceEventBluetooth, 0, connected);
     if (connected)
     {
-        schedule_weather_request(NOW);
+        if (s_bt_disconnect_timer)
+        {
+            app_timer_cancel(s_bt_disconnect_timer);
+            s_bt_disconnect_timer = NULL;
+            s_connection_stats.suppressed_disconnects++;
+        }
+        bt_reconnected();
+        s_context.bluetooth_connected = true;
+        refresh_watch_status();
+    }
+    else if (!s_bt_disconnect_timer)
+    {
+        s_bt_disconnect_timer = app_timer_register(BT_DISCONNECT_HOLD, bt_disconnect_hold_callback, NULL);
     }
-    s_context.bluetooth_connected = connected;
-    update_watch_info_layer_visibility();
-    text_block_mark_dirty(s_watch_info);
 }
 
 static void battery_handler(BatteryChargeState charge)
 {
+    trace_record(TraceEventBattery, 0, charge.charge_percent | charge.is_charging << 8 | charge.is_plugged << 9);
     s_context.charge_state = charge;
-    update_watch_info_layer_visibility();
-    text_block_mark_dirty(s_watch_info);
+    update_power_profile();
+    refresh_watch_status();
 }
 
+#ifndef HEALTH_DISABLED
 static void step_handler(HealthEventType event, void *context)
 {
     if (event == HealthEventSignificantUpdate)
@@ -634,10 +1161,23 @@ static void step_handler(HealthEventType event, void *context)
         fetch_step((Context *)context);
         text_block_mark_dirty(s_steps_info);
     }
+    if (event == HealthEventSleepUpdate || event == HealthEventSignificantUpdate)
+    {
+        refresh_sleeping();
+        update_power_profile();
+    }
+    const int steps = ((Context *)context)->steps;
+    trace_record(TraceEventHealth, event, steps < UINT16_MAX ? steps : UINT16_MAX);
 }
+#endif
 
 static void tick_handler(struct tm *tick_time, TimeUnits units_changed)
 {
+    trace_record(TraceEventTick, units_changed, tick_time->tm_hour * 60 + tick_time->tm_min);
+    int hour;
+    const int32_t today = energy_today(&hour);
+    energy_roll(today, hour, energy_report);
+    energy_count(EnergyTicks, 1);
     if (HOUR_UNIT & units_changed)
     {
         const bool vibrate_on_the_hour = config_get_bool(s_config, ConfigKeyVibrateOnTheHour);
@@ -645,16 +1185,20 @@ static void tick_handler(struct tm *tick_time, TimeUnits units_changed)
         if (vibrate_on_the_hour && !quiet_time)
         {
             if (PBL_IF_HEALTH_ELSE(config_get_bool(s_config, ConfigKeyHealthEnabled), false) ||
-                !(health_service_peek_current_activities() &
-                  (HealthActivitySleep | HealthActivityRestfulSleep)))
+                !s_context.sleeping)
             {
                 vibes_short_pulse();
+                energy_count(EnergyVibrations, 1);
             }
         }
     }
     schedule_weather_request(10000);
-    update_current_time();
+    update_current_time(tick_time);
+    update_power_profile();
+    note_energy_settings();
     fetch_step(&s_context);
+    refresh_watch_status();
+    refresh_daylight();
 
     layer_mark_dirty(s_hour_hand_layer);
     layer_mark_dirty(s_tick_layer);
@@ -665,7 +1209,7 @@ static void tick_handler(struct tm *tick_time, TimeUnits units_changed)
     text_block_mark_dirty(s_date_info);
     text_block_mark_dirty(s_steps_info);
 
-    quadrants_update(s_quadrants, s_current_time);
+    quadrants_update(s_quadrants, &s_context.time);
 }
 
 static void implementation_update(Animation *animation,
@@ -685,6 +1229,7 @@ static GPoint s_new_center;
 
 static void unobstructed_area_will_change_handler(GRect final_unobstructed_screen_area, void *context)
 {
+    trace_record(TraceEventUnobstructedWillChange, 0, final_unobstructed_screen_area.size.h);
     s_old_center = g_center;
     s_new_center = grect_center_point(&final_unobstructed_screen_area);
     tick_points_will_change(&final_unobstructed_screen_area);
@@ -693,9 +1238,10 @@ static void unobstructed_area_will_change_handler(GRect final_unobstructed_scree
 
 static void unobstructed_area_change_handler(AnimationProgress progress, void *context)
 {
+    trace_record(TraceEventUnobstructedChange, 0, progress);
     g_center = gpoint_lerp_anim(s_old_center, s_new_center, progress);
     quadrants_unobstructed_area_changing(progress);
-    quadrants_update(s_quadrants, s_current_time);
+    quadrants_update(s_quadrants, &s_context.time);
     layer_mark_dirty(s_hour_hand_layer);
     mark_dirty_minute_hand_layer();
     s_unob_area_anim_progress = progress;
@@ -703,13 +1249,53 @@ static void unobstructed_area_change_handler(AnimationProgress progress, void *c
 
 static void unobstructed_area_did_change_handler(void *context)
 {
+    trace_record(TraceEventUnobstructedDidChange, 0, 0);
     g_center = s_new_center;
-    quadrants_unobstructed_area_done();
-    quadrants_update(s_quadrants, s_current_time);
     tick_points_done_changing();
+    quadrants_unobstructed_area_done();
+    quadrants_update(s_quadrants, &s_context.time);
     s_unob_area_anim_progress = ANIMATION_NORMALIZED_MIN;
 }
 
+#ifdef BENCHMARK
+// Benchmark
+
+// Builds for scripts/benchmark.sh replace the tick service with an hour of
+// minute ticks from BENCHMARK, a local time in seconds since the epoch, one
+// every BENCHMARK_TICK_INTERVAL once the startup animation is over. Quick
+// View, the config push and the weather replies come from the script and the
+// phone side meanwhile. At the end the counters and the trace are sent to the
+// phone log.
+#define BENCHMARK_START_DELAY 2000
+#define BENCHMARK_TICK_INTERVAL 500
+#define BENCHMARK_TICKS 60
+
+static int s_benchmark_tick;
+
+static void benchmark_tick_callback(void *data)
+{
+    if (s_benchmark_tick == BENCHMARK_TICKS)
+    {
+        i("benchmark done after %d ticks", BENCHMARK_TICKS);
+        energy_report_today(energy_report);
+        trace_requested_callback(NULL, NULL);
+        return;
+    }
+    s_benchmark_time = (time_t)BENCHMARK + s_benchmark_tick * 60;
+    tm local = *gmtime(&s_benchmark_time);
+    const TimeUnits units_changed = MINUTE_UNIT | (local.tm_min == 0 ? HOUR_UNIT : 0);
+    tick_handler(&local, units_changed);
+    s_benchmark_tick++;
+    app_timer_register(BENCHMARK_TICK_INTERVAL, benchmark_tick_callback, NULL);
+}
+
+static void benchmark_start()
+{
+    s_benchmark_tick = 0;
+    app_timer_register(BENCHMARK_START_DELAY, benchmark_tick_callback, NULL);
+}
+#endif
+
 static void main_window_load(Window *window)
 {
     s_root_layer = window_get_root_layer(window);
@@ -717,36 +1303,50 @@ static void main_window_load(Window *window)
     GRect unob_bounds = layer_get_unobstructed_bounds(s_root_layer);
     g_center = grect_center_point(&unob_bounds);
     tick_points_init(&unob_bounds);
-    update_current_time();
+    const time_t now = time(NULL);
+    update_current_time(localtime(&now));
+    s_context.charge_state = battery_state_service_peek();
+    refresh_sleeping();
+    update_power_profile();
+    note_energy_settings();
     window_set_background_color(window, config_get_color(s_config, ConfigKeyBackgroundColor));
-    
+
+#ifndef HEALTH_DISABLED
+    s_step_ring = step_ring_create(s_root_layer);
+    step_ring_set_color(s_step_ring, config_get_color(s_config, ConfigKeyInfoColor));
+#endif
+    update_step_ring_visibility();
+
     s_quadrants = quadrants_create(g_center, HOUR_HAND_RADIUS, MINUTE_HAND_RADIUS, s_root_layer);
-    s_date_info = quadrants_add_text_block(s_quadrants, s_root_layer, s_font, Low, s_current_time);
+    quadrants_set_mode(s_quadrants, LayoutStable);
+    s_date_info = quadrants_add_text_block(s_quadrants, s_root_layer, s_font, Low);
     text_block_set_enabled(s_date_info, config_get_bool(s_config, ConfigKeyDateDisplayed));
     text_block_set_context(s_date_info, &s_context);
     text_block_set_update_proc(s_date_info, date_info_update_proc);
 
-    s_steps_info = quadrants_add_text_block(s_quadrants, s_root_layer, s_font, High, s_current_time);
+    s_steps_info = quadrants_add_text_block(s_quadrants, s_root_layer, s_font, High);
     text_block_set_enabled(s_steps_info, config_get_bool(s_config, ConfigKeyHealthEnabled));
     text_block_set_context(s_steps_info, &s_context);
     text_block_set_update_proc(s_steps_info, steps_info_update_proc);
+#ifndef HEALTH_DISABLED
     health_service_events_subscribe(step_handler, &s_context);
+#endif
     fetch_step(&s_context);
 
-    s_weather_info = quadrants_add_text_block(s_quadrants, s_root_layer, s_font, Head, s_current_time);
+    s_weather_info = quadrants_add_text_block(s_quadrants, s_root_layer, s_font, Head);
     text_block_set_enabled(s_weather_info, config_get_bool(s_config, ConfigKeyWeatherEnabled));
     text_block_mark_dirty(s_weather_info);
     text_block_set_context(s_weather_info, &s_context);
     text_block_set_update_proc(s_weather_info, weather_info_update_proc);
 
-    s_watch_info = quadrants_add_text_block(s_quadrants, s_root_layer, s_font, Tail, s_current_time);
+    s_watch_info = quadrants_add_text_block(s_quadrants, s_root_layer, s_font, Tail);
     text_block_set_context(s_watch_info, &s_context);
     text_block_set_update_proc(s_watch_info, watch_info_update_proc);
     bluetooth_connection_service_subscribe(bt_handler);
-    bt_handler(connection_service_peek_pebble_app_connection());
+    s_context.bluetooth_connected = connection_service_peek_pebble_app_connection();
     battery_state_service_subscribe(battery_handler);
-    battery_handler(battery_state_service_peek());
-    update_watch_info_layer_visibility();
+    s_context.watch_status = compute_watch_status(&s_context);
+    text_block_set_enabled(s_watch_info, s_context.watch_status != 0);
 
     s_hour_text = text_block_create(s_root_layer, get_time_position(6, ANIMATION_NORMALIZED_MIN), s_font);
     text_block_set_context(s_hour_text, &s_context);
@@ -763,10 +1363,11 @@ static void main_window_load(Window *window)
     layer_set_update_proc(s_tick_layer, tick_layer_update_callback);
     layer_add_child(s_root_layer, s_tick_layer);
 
-    s_rainbow_bitmap = gbitmap_create_with_resource(RESOURCE_ID_IMG_RAINBOW_HAND);
     s_minute_hand_layer = layer_create(s_root_layer_bounds);
     s_hour_hand_layer = layer_create(s_root_layer_bounds);
     s_center_circle_layer = layer_create(s_root_layer_bounds);
+#ifndef RAINBOW_DISABLED
+    s_rainbow_bitmap = gbitmap_create_with_resource(RESOURCE_ID_IMG_RAINBOW_HAND);
     s_rainbow_hand_layer = rot_bitmap_layer_create(s_rainbow_bitmap);
     rot_bitmap_set_compositing_mode(s_rainbow_hand_layer, GCompOpSet);
     const GPoint png_center = GPoint(RAINBOW_HAND_OFFSET_X, RAINBOW_HAND_OFFSET_Y);
@@ -775,20 +1376,27 @@ static void main_window_load(Window *window)
     frame.origin.x = g_center.x - frame.size.w / 2;
     frame.origin.y = g_center.y - frame.size.h / 2;
     layer_set_frame((Layer *)s_rainbow_hand_layer, frame);
+#endif
     layer_set_update_proc(s_hour_hand_layer, update_hour_hand_layer);
     layer_set_update_proc(s_minute_hand_layer, update_minute_hand_layer);
     layer_set_update_proc(s_center_circle_layer, update_center_circle_layer);
     layer_add_child(s_root_layer, s_minute_hand_layer);
+#ifndef RAINBOW_DISABLED
     layer_add_child(s_root_layer, (Layer *)s_rainbow_hand_layer);
+#endif
     layer_add_child(s_root_layer, s_hour_hand_layer);
     layer_add_child(s_root_layer, s_center_circle_layer);
     mark_dirty_minute_hand_layer();
 
+#ifndef BENCHMARK
     tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
+#else
+    benchmark_start();
+#endif
 
-    quadrants_update(s_quadrants, s_current_time);
+    quadrants_update(s_quadrants, &s_context.time);
 
-    if (config_get_bool(s_config, ConfigKeyAnimationEnabled))
+    if (config_get_bool(s_config, ConfigKeyAnimationEnabled) && power_policy(s_context.power_profile)->animation)
     {
         s_animation_progress = 0;
 
@@ -819,21 +1427,31 @@ static void main_window_load(Window *window)
 static void main_window_unload(Window *window)
 {
     layer_destroy(s_hour_hand_layer);
-    rot_bitmap_layer_destroy(s_rainbow_hand_layer);
     layer_destroy(s_minute_hand_layer);
     layer_destroy(s_center_circle_layer);
+#ifndef RAINBOW_DISABLED
+    rot_bitmap_layer_destroy(s_rainbow_hand_layer);
     gbitmap_destroy(s_rainbow_bitmap);
+#endif
 
     text_block_destroy(s_hour_text);
     text_block_destroy(s_minute_text);
 
     layer_destroy(s_tick_layer);
+#ifndef HEALTH_DISABLED
+    s_step_ring = step_ring_destroy(s_step_ring);
 
     if (config_get_bool(s_config, ConfigKeyHealthEnabled))
     {
         health_service_events_unsubscribe();
     }
+#endif
     bluetooth_connection_service_unsubscribe();
+    if (s_bt_disconnect_timer)
+    {
+        app_timer_cancel(s_bt_disconnect_timer);
+        s_bt_disconnect_timer = NULL;
+    }
 
     s_quadrants = quadrants_destroy(s_quadrants);
 
@@ -845,44 +1463,84 @@ static void main_window_unload(Window *window)
 
 static void init()
 {
+    trace_init();
+    s_trace_chunk = -1;
     static const Message messages[] = {
         {AppKeyJsReady, js_ready_callback},
+        {AppKeyTrace, trace_requested_callback},
+#ifndef WEATHER_DISABLED
+        {AppKeyWeather, weather_callback},
         {AppKeyWeatherTemperature, weather_requested_callback},
         {AppKeyWeatherFailed, weather_request_failed_callback},
-        {AppKeyBackgroundColor, config_background_color_updated},
-        {AppKeyHourHandColor, config_hour_hand_color_updated},
-        {AppKeyInfoColor, config_info_color_updated},
-        {AppKeyMinuteHandColor, config_minute_hand_color_updated},
-        {AppKeyTimeColor, config_time_color_updated},
-        {AppKeyDateDisplayed, config_date_displayed_updated},
-        {AppKeyRainbowMode, config_rainbow_mode_updated},
-        {AppKeyBluetoothIcon, config_bluetooth_icon_updated},
-        {AppKeyRefreshRate, config_refresh_rate_updated},
-        {AppKeyTemperatureUnit, config_temperature_unit_updated},
-        {AppKeyWeatherEnabled, config_weather_enabled_updated},
-        {AppKeyVibrateOnTheHour, config_hourly_vibrate_updated},
-        {AppKeyHealthEnabled, config_health_enabled_updated},
-        {AppKeyBatteryDisplayedAt, config_battery_displayed_at_updated},
-        {AppKeyQuietTimeVisible, config_quiet_time_visible_updated},
-        {AppKeyAnimationEnabled, config_animation_enabled}};
+        {AppKeyLocation, location_callback},
+#endif
+#ifndef CONFIG_FROZEN
+        {AppKeyBackgroundColor, config_value_updated},
+        {AppKeyHourHandColor, config_value_updated},
+        {AppKeyInfoColor, config_value_updated},
+        {AppKeyMinuteHandColor, config_value_updated},
+        {AppKeyPalette, config_palette_updated},
+        {AppKeyTimeColor, config_value_updated},
+        {AppKeyDateDisplayed, config_value_updated},
+        {AppKeyRainbowMode, config_value_updated},
+        {AppKeyBluetoothIcon, config_value_updated},
+        {AppKeyRefreshRate, config_value_updated},
+        {AppKeyTemperatureUnit, config_value_updated},
+        {AppKeyWeatherEnabled, config_value_updated},
+        {AppKeyVibrateOnTheHour, config_value_updated},
+        {AppKeyHealthEnabled, config_value_updated},
+        {AppKeyBatteryDisplayedAt, config_value_updated},
+        {AppKeyQuietTimeVisible, config_value_updated},
+        {AppKeyAnimationEnabled, config_value_updated},
+        {AppKeyStepRingEnabled, config_value_updated},
+#endif
+    };
     s_messenger = messenger_create(sizeof(messages) / sizeof(Message), messenger_callback, messages);
+    messenger_set_outbox_callback(s_messenger, outbox_callback);
+    int hour;
+    const int32_t today = energy_today(&hour);
+    energy_load(PersistKeyEnergy, today, hour, energy_report);
     s_weather_request_timeout = 0;
     s_js_ready = false;
     s_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_NUPE_23));
+#ifndef CONFIG_FROZEN
     s_config = config_load(PersistKeyConfig, CONF_SIZE, CONF_DEFAULTS);
+#endif
     s_context = (Context){
         .config = s_config,
         .steps = 0,
+        .weather_failures = 0,
         .reset_weather = false,
+        .location_known = false,
         .bluetooth_connected = false,
+        .watch_status = 0,
+        .power_profile = PowerProfileNormal,
+        .sleeping = false,
         .charge_state = (BatteryChargeState){
             .charge_percent = 100,
             .is_charging = false,
-            .is_plugged = false},
-        .time = NULL};
+            .is_plugged = false}};
+    if (persist_exists(PersistKeyLegacyWeather))
+    {
+        persist_delete(PersistKeyLegacyWeather);
+    }
     if (persist_exists(PersistKeyWeather))
     {
         persist_read_data(PersistKeyWeather, &s_context.weather, sizeof(Weather));
+        if (s_context.weather.version != WEATHER_VERSION)
+        {
+            s_context.weather = (Weather){0};
+        }
+    }
+    if (persist_exists(PersistKeyLocation))
+    {
+        persist_read_data(PersistKeyLocation, &s_context.location, sizeof(Coordinates));
+        s_context.location_known = true;
+        s_context.daylight = solar_is_day(&s_context.location, time(NULL));
+    }
+    if (persist_exists(PersistKeyStepAverage))
+    {
+        persist_read_data(PersistKeyStepAverage, &s_context.step_average, sizeof(StepAverage));
     }
     s_main_window = window_create();
     window_set_window_handlers(s_main_window, (WindowHandlers){
@@ -897,8 +1555,11 @@ static void deinit()
     app_message_deregister_callbacks();
     window_stack_remove(s_main_window, true);
     window_destroy(s_main_window);
+#ifndef CONFIG_FROZEN
     s_config = config_destroy(s_config);
+#endif
     fonts_unload_custom_font(s_font);
+    energy_save(PersistKeyEnergy);
     s_messenger = messenger_destroy(s_messenger);
 }
 
@@ -907,4 +1568,5 @@ int main(void)
     init();
     app_event_loop();
     deinit();
+    return 0;
 }
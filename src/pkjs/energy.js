@@ -0,0 +1,174 @@
+"use strict";
+
+var trace = require('./trace.js');
+
+// The watch sends the counts of each finished day as AppKeyEnergy: an
+// EnergyDay (see energy.h), the settings and counters of every hour. They are
+// turned into an estimated cost per subsystem to compare settings, like a
+// short weather refresh rate or the rainbow mode, by how much battery they
+// take.
+var VERSION = 2;
+var HOURS = 24;
+var HEADER_SIZE = 8;
+var SETTINGS_SIZE = 2;
+var COUNTERS_OFFSET = HEADER_SIZE + HOURS * SETTINGS_SIZE;
+
+// EnergySettingsFlag
+var PROFILE_MASK = 0x03;
+var RAINBOW = 0x04;
+var WEATHER = 0x08;
+var HEALTH = 0x10;
+// In the order of PowerProfile.
+var PROFILES = ['normal', 'saving', 'sleeping'];
+
+// In the order of EnergyCounter.
+var COUNTERS = [
+    'frames', 'kilopixels', 'drawCalls',
+    'redrawRing', 'redrawText', 'redrawTicks', 'redrawHands', 'redrawRainbow',
+    'messagesIn', 'bytesIn', 'messagesOut', 'bytesOut',
+    'persistWrites', 'persistBytes',
+    'healthCalls', 'vibrations', 'timerWakeups', 'ticks'
+];
+
+// Rough cost of one count, in µAh. These are relative weights to rank the
+// subsystems against each other, not measurements.
+var COSTS = {
+    display: { frames: 1.0, kilopixels: 0.02, drawCalls: 0.02 },
+    rainbow: { redrawRainbow: 2.0 },
+    radio: { messagesIn: 20, bytesIn: 0.05, messagesOut: 20, bytesOut: 0.05 },
+    storage: { persistWrites: 5, persistBytes: 0.02 },
+    health: { healthCalls: 2 },
+    vibration: { vibrations: 30 },
+    wakeups: { timerWakeups: 0.2, ticks: 0.3 }
+};
+
+var LOG_PREFIX = 'energy-day ';
+
+// The raw counts for the log, which scripts/benchmark_report.js reads back.
+var format = function (bytes) {
+    return LOG_PREFIX + trace.hex(bytes);
+};
+
+var uint16 = function (bytes, offset) {
+    return (bytes[offset] & 0xff) | (bytes[offset + 1] & 0xff) << 8;
+};
+
+// Returns { day, settings, hours } where day is the local midnight of the
+// report in seconds since the epoch, settings holds the settings of each hour,
+// null when the face did not run in it, and hours the counters of each hour.
+// Returns null when the payload is not an EnergyDay this code knows.
+var parse = function (bytes) {
+    if (!bytes || bytes.length < HEADER_SIZE || (bytes[0] & 0xff) !== VERSION) {
+        return null;
+    }
+    var counters = bytes[1] & 0xff;
+    if (counters !== COUNTERS.length || bytes.length !== COUNTERS_OFFSET + HOURS * counters * 2) {
+        return null;
+    }
+    var day = (bytes[4] & 0xff) | (bytes[5] & 0xff) << 8 | (bytes[6] & 0xff) << 16 | (bytes[7] & 0xff) << 24;
+    var settings = [];
+    var hours = [];
+    for (var hour = 0; hour < HOURS; hour++) {
+        var refreshRate = bytes[HEADER_SIZE + hour * SETTINGS_SIZE] & 0xff;
+        var flags = bytes[HEADER_SIZE + hour * SETTINGS_SIZE + 1] & 0xff;
+        settings.push(refreshRate === 0 ? null : {
+            refreshRate: refreshRate,
+            profile: PROFILES[flags & PROFILE_MASK] || 'normal',
+            rainbow: !!(flags & RAINBOW),
+            weather: !!(flags & WEATHER),
+            health: !!(flags & HEALTH)
+        });
+        var counts = {};
+        for (var i = 0; i < counters; i++) {
+            counts[COUNTERS[i]] = uint16(bytes, COUNTERS_OFFSET + (hour * counters + i) * 2);
+        }
+        hours.push(counts);
+    }
+    return { day: day, settings: settings, hours: hours };
+};
+
+// What the day ran with: the refresh rates it used, in minutes, and how many
+// hours it ran, with the rainbow hand and in each power profile.
+var active = function (report) {
+    var result = { refreshRates: [], hours: 0, rainbowHours: 0, profileHours: {} };
+    PROFILES.forEach(function (profile) {
+        result.profileHours[profile] = 0;
+    });
+    report.settings.forEach(function (settings) {
+        if (!settings) {
+            return;
+        }
+        result.hours++;
+        result.rainbowHours += settings.rainbow ? 1 : 0;
+        result.profileHours[settings.profile]++;
+        if (result.refreshRates.indexOf(settings.refreshRate) < 0) {
+            result.refreshRates.push(settings.refreshRate);
+        }
+    });
+    result.refreshRates.sort(function (a, b) {
+        return a - b;
+    });
+    return result;
+};
+
+var totals = function (report) {
+    var sums = {};
+    COUNTERS.forEach(function (name) {
+        sums[name] = 0;
+    });
+    report.hours.forEach(function (counts) {
+        COUNTERS.forEach(function (name) {
+            sums[name] += counts[name];
+        });
+    });
+    return sums;
+};
+
+// Estimated µAh per subsystem over the day, and their total.
+var estimate = function (report) {
+    var sums = totals(report);
+    var costs = { total: 0 };
+    Object.keys(COSTS).forEach(function (subsystem) {
+        var cost = 0;
+        Object.keys(COSTS[subsystem]).forEach(function (name) {
+            cost += sums[name] * COSTS[subsystem][name];
+        });
+        costs[subsystem] = Math.round(cost);
+        costs.total += costs[subsystem];
+    });
+    return costs;
+};
+
+// One log line: the day, the settings the costs were measured with and the
+// subsystems from the most to the least expensive.
+var summary = function (report) {
+    var costs = estimate(report);
+    var settings = active(report);
+    var rainbow = settings.rainbowHours === 0 ? 'off' :
+        settings.rainbowHours === settings.hours ? 'on' : 'on ' + settings.rainbowHours + ' h';
+    var measured = ['refresh ' + (settings.refreshRates.join('/') || '-') + ' min', 'rainbow ' + rainbow];
+    PROFILES.slice(1).forEach(function (profile) {
+        if (settings.profileHours[profile] > 0) {
+            measured.push(profile + ' ' + settings.profileHours[profile] + ' h');
+        }
+    });
+    // The day starts at the local midnight, which the phone shares.
+    var start = new Date(report.day * 1000);
+    var date = start.getFullYear() + '-' + ('0' + (start.getMonth() + 1)).slice(-2) + '-' + ('0' + start.getDate()).slice(-2);
+    var subsystems = Object.keys(COSTS).sort(function (a, b) {
+        return costs[b] - costs[a];
+    }).map(function (subsystem) {
+        return subsystem + ' ' + costs[subsystem];
+    });
+    return 'energy ' + date + ' (' + measured.join(', ') + '): ' + costs.total + ' µAh, ' + subsystems.join(', ');
+};
+
+module.exports = {
+    COUNTERS: COUNTERS,
+    format: format,
+    parse: parse,
+    active: active,
+    totals: totals,
+    estimate: estimate,
+    summary: summary
+};
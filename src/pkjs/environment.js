@@ -0,0 +1,12 @@
+"use strict";
+
+// What the phone side talks to. scripts/benchmark.sh builds a copy of the
+// project where this file points at a local weather stand-in, with a location
+// to use when none is set and the config it pushes to the watch during the
+// scenario.
+module.exports = {
+    forecastUrl: 'https://api.open-meteo.com/v1/forecast',
+    geocodeUrl: 'https://photon.komoot.io/api',
+    location: null,
+    benchmark: null
+};
@@ -0,0 +1,38 @@
+"use strict";
+
+// Open-Meteo computes the current conditions every 15 minutes and reports the
+// start of that slot as current.time, so they can be up to 15 minutes old when
+// they arrive. How long weather stays valid is measured from when it was
+// fetched instead, so that refreshes keep to the configured rate.
+var read = function (response, fetched) {
+    var current = response.current;
+    return {
+        temperature: Math.round(current.temperature_2m),
+        code: current.weather_code,
+        isDay: !!current.is_day,
+        observed: current.time || fetched,
+        fetched: fetched
+    };
+};
+
+// Whether a cache entry, which records when it was fetched, is younger than
+// maxAge seconds.
+var fresh = function (cache, now, maxAge) {
+    return !!cache && typeof cache.fetched === 'number' && now - cache.fetched < maxAge;
+};
+
+// The watch asks again as soon as its weather expires, a refresh seconds
+// after it was fetched. A cache entry is only served with a margin before
+// then, which covers the clock skew between phone and watch, so that the watch
+// does not take it as expired and ask again right away.
+var SERVE_MARGIN = 2 * 60;
+
+var servable = function (cache, now, refresh) {
+    return fresh(cache, now, refresh - SERVE_MARGIN);
+};
+
+module.exports = {
+    read: read,
+    fresh: fresh,
+    servable: servable
+};
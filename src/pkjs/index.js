@@ -3,12 +3,23 @@
 var Clay = require('pebble-clay');
 var clayConfig = require('./config.json');
 var clayFunction = require('./clayFunction.js');
+var RequestManager = require('./requests.js');
+var settings = require('./settings.js');
+var protocol = require('./protocol.js');
+var Streamer = require('./streamer.js');
+var trace = require('./trace.js');
+var energy = require('./energy.js');
+var environment = require('./environment.js');
+var forecast = require('./forecast.js');
 var clay = new Clay(clayConfig, clayFunction, { autoHandleEvents: false });
 
 var Weather = function (pebble) {
-    var GET = 'GET';
-    var BASE_URL = 'https://api.open-meteo.com/v1/forecast';
-    var BASE_GEOCODE_URL = 'https://photon.komoot.io/api';
+    var requests = RequestManager();
+    var GEOLOCATION_DEADLINE = 25000;
+    var GEOCODE_DEADLINE = 10000;
+    var FORECAST_DEADLINE = 10000;
+    var BASE_URL = environment.forecastUrl;
+    var BASE_GEOCODE_URL = environment.geocodeUrl;
     var ICONS = {
         0: 'a',
         1: 'b',
@@ -41,9 +52,36 @@ var Weather = function (pebble) {
         45: 'i',
         48: 'i',
     };
-    var LOCATION_OPTS = {
+    var COARSE_LOCATION_OPTS = {
+        'enableHighAccuracy': false,
         'timeout': 5000,
-        'maximumAge': 30 * 60 * 1000
+        'maximumAge': 60 * 60 * 1000
+    };
+    var LOCATION_OPTS = {
+        'enableHighAccuracy': true,
+        'timeout': 15000,
+        'maximumAge': 0
+    };
+
+    // Mirrors the packed Weather struct in minimalin.c:
+    // version, icon, temperature, failed, then the fetch time as little endian uint32.
+    var WEATHER_VERSION = 1;
+
+    var packWeather = function (icon, temperature, timestamp, failed) {
+        return [
+            WEATHER_VERSION,
+            icon & 0xff,
+            temperature & 0xff,
+            failed ? 1 : 0,
+            timestamp & 0xff,
+            (timestamp >>> 8) & 0xff,
+            (timestamp >>> 16) & 0xff,
+            (timestamp >>> 24) & 0xff
+        ];
+    };
+
+    var now = function () {
+        return Math.floor(Date.now() / 1000);
     };
 
     var parseIcon = function (icon, is_day) {
@@ -71,105 +109,338 @@ var Weather = function (pebble) {
 
         var url = BASE_GEOCODE_URL + '?limit=1&q=' + location;
         console.log("Fetching location " + url);
-        var req = new XMLHttpRequest();
-        req.open(GET, url, true);
-        req.onload = function () {
-            if (req.status === 200) {
-                var resp = JSON.parse(req.responseText);
-                if (resp.features.length != 1) {
-                    localStorage.setItem(GEOCODE_FETCH_CACHE, JSON.stringify({
-                        location: location,
-                        failed: true
-                    }));
-                    callbackError("geocode failed: features.length != 1");
-                    return;
-                }
-                var coords = resp.features[0].geometry.coordinates;
-                var lat = coords[1];
-                var long = coords[0];
-                console.log("geocode success: long:" + long + ", lat:" + lat);
-                var cache = {
+        requests.getJson('geocode', url, GEOCODE_DEADLINE, function (resp) {
+            if (resp.features.length != 1) {
+                localStorage.setItem(GEOCODE_FETCH_CACHE, JSON.stringify({
                     location: location,
-                    latitude: lat,
-                    longitude: long
-                };
-                localStorage.setItem(GEOCODE_FETCH_CACHE, JSON.stringify(cache))
-                callbackSuccess(lat, long);
+                    failed: true
+                }));
+                callbackError("geocode failed: features.length != 1");
+                return;
             }
-            else {
-                callbackError("geocode error: status " + req.status);
+            var coords = resp.features[0].geometry.coordinates;
+            var lat = coords[1];
+            var long = coords[0];
+            console.log("geocode success: long:" + long + ", lat:" + lat);
+            var cache = {
+                location: location,
+                latitude: lat,
+                longitude: long
+            };
+            localStorage.setItem(GEOCODE_FETCH_CACHE, JSON.stringify(cache))
+            callbackSuccess(lat, long);
+        }, callbackError);
+    };
+
+    var WEATHER_CACHE = "weatherCache";
+    var LAST_FIX = "lastFix";
+    var LAST_FIX_MAX_AGE = 10 * 60;
+    var MOVE_THRESHOLD_KM = 2;
+    var READY_WEATHER_TIMEOUT = 10000;
+    var LOCATION_SENT = "locationSent";
+    var ENERGY_REPORTS = "energyReports";
+    var ENERGY_REPORTS_KEPT = 7;
+
+    var loadSettings = function () {
+        try {
+            return JSON.parse(localStorage.getItem('clay-settings')) || {};
+        } catch (e) {
+            return {};
+        }
+    };
+
+    // The default is CONFIG_REFRESH_RATE, which the watch uses until the
+    // settings are saved.
+    var refreshRate = function (settings) {
+        return (settings.AppKeyRefreshRate || 20) * 60;
+    };
+
+    // The watch sends the refresh rate of its power profile, in seconds, with
+    // its requests. Older ones send 1, the settings are used then.
+    var watchRefresh = function (request) {
+        return request >= 60 ? request : refreshRate(loadSettings());
+    };
+
+    var cachedWeather = function (refresh) {
+        var cache = JSON.parse(localStorage.getItem(WEATHER_CACHE));
+        if (forecast.servable(cache, now(), refresh)) {
+            return cache.data;
+        }
+        return null;
+    };
+
+    // Equirectangular approximation, plenty for a few kilometers.
+    var distanceKm = function (latitudeA, longitudeA, latitudeB, longitudeB) {
+        var toRad = Math.PI / 180;
+        var x = (longitudeB - longitudeA) * toRad * Math.cos((latitudeA + latitudeB) / 2 * toRad);
+        var y = (latitudeB - latitudeA) * toRad;
+        return Math.sqrt(x * x + y * y) * 6371;
+    };
+
+    var cachedWeatherNear = function (latitude, longitude, refresh) {
+        var cache = JSON.parse(localStorage.getItem(WEATHER_CACHE));
+        if (!forecast.servable(cache, now(), refresh) || cache.latitude === undefined) {
+            return null;
+        }
+        if (distanceKm(cache.latitude, cache.longitude, latitude, longitude) >= MOVE_THRESHOLD_KM) {
+            return null;
+        }
+        return cache.data;
+    };
+
+    // Our own last fix is used first, then whatever coarse or cached position
+    // the phone already has, and only then a fresh GPS fix.
+    var locate = function (callbackSuccess, callbackError) {
+        var lastFix = JSON.parse(localStorage.getItem(LAST_FIX));
+        if (lastFix && now() - lastFix.timestamp < LAST_FIX_MAX_AGE) {
+            callbackSuccess(lastFix.latitude, lastFix.longitude);
+            return;
+        }
+        var success = function (pos) {
+            var coordinates = pos.coords;
+            localStorage.setItem(LAST_FIX, JSON.stringify({
+                latitude: coordinates.latitude,
+                longitude: coordinates.longitude,
+                timestamp: now()
+            }));
+            callbackSuccess(coordinates.latitude, coordinates.longitude);
+        };
+        requests.run('geolocation', GEOLOCATION_DEADLINE, function (resolve, reject) {
+            window.navigator.geolocation.getCurrentPosition(resolve, function () {
+                window.navigator.geolocation.getCurrentPosition(resolve, reject, LOCATION_OPTS);
+            }, COARSE_LOCATION_OPTS);
+        }, success, callbackError);
+    };
+
+    // The watch works out day and night itself from a coarse position, in
+    // tenths of a degree, which is sent with the first weather after each
+    // launch and then only again once it changes.
+    var packLocation = function (latitude, longitude) {
+        var lat = Math.round(latitude * 10);
+        var lon = Math.round(longitude * 10);
+        return [lat & 0xff, (lat >> 8) & 0xff, lon & 0xff, (lon >> 8) & 0xff];
+    };
+
+    var withLocation = function (latitude, longitude, done) {
+        return function (data) {
+            var location = packLocation(latitude, longitude);
+            if (localStorage.getItem(LOCATION_SENT) !== JSON.stringify(location)) {
+                data.AppKeyLocation = location;
             }
+            done(data);
         };
-        req.onerror = function() { callbackError("geocode error: request failed"); };
-        req.send(null);
     };
 
-    var fetchWeatherForLocation = function (location) {
-        fetchLocation(location, fetchWeatherForCoordinates, weatherError);
+    var fetchWeatherForLocation = function (location, refresh, done) {
+        fetchLocation(location, function (latitude, longitude) {
+            fetchWeatherForCoordinates(latitude, longitude, refresh, done);
+        }, function (err) {
+            weatherError(err, done);
+        });
     };
 
-    var fetchWeatherForCoordinates = function (latitude, longitude) {
+    var fetchWeatherForCoordinates = function (latitude, longitude, refresh, done) {
+        done = withLocation(latitude, longitude, done);
+        var cached = cachedWeatherNear(latitude, longitude, refresh);
+        if (cached) {
+            console.log('weather: cached observation still valid, skipping fetch');
+            done({ 'AppKeyWeather': cached.AppKeyWeather });
+            return;
+        }
         var query = 'latitude=' + latitude + '&longitude=' + longitude;
-        fetchWeather(query);
+        fetchWeather(query, latitude, longitude, done);
     };
 
-    var fetchWeather = function (query) {
+    var fetchWeather = function (query, latitude, longitude, done) {
         localStorage.removeItem("lastCoordFetch");
-        var req = new XMLHttpRequest();
-        query += '&current=temperature_2m,weather_code,is_day';
+        query += '&current=temperature_2m,weather_code,is_day&timeformat=unixtime';
         console.log('query: ' + query);
-        req.open(GET, BASE_URL + '?' + query, true);
-        req.onload = function () {
-            if (req.status === 200) {
-                var response = JSON.parse(req.responseText);
-                var temperature = Math.round(response.current.temperature_2m);
-                var icon = parseIcon(response.current.weather_code, !!response.current.is_day);
-                var data = {
-                    'AppKeyWeatherIcon': icon,
-                    'AppKeyWeatherTemperature': temperature
-                };
-                console.log('fetchWeather sendAppMessage:', JSON.stringify(data));
-                pebble.sendAppMessage(data);
-            } else {
-                weatherError("weather query failed, request status: " + req.status);
-            }
-        };
-        req.onerror = function () { weatherError("weather query failed (onerror)"); };
-        req.send(null);
+        requests.getJson('forecast', BASE_URL + '?' + query, FORECAST_DEADLINE, function (response) {
+            var reading = forecast.read(response, now());
+            var icon = parseIcon(reading.code, reading.isDay);
+            var data = {
+                'AppKeyWeather': packWeather(icon, reading.temperature, reading.fetched, false)
+            };
+            localStorage.setItem(WEATHER_CACHE, JSON.stringify({
+                fetched: reading.fetched,
+                latitude: latitude,
+                longitude: longitude,
+                data: data
+            }));
+            done(data);
+        }, function (err) {
+            weatherError("weather query failed: " + err, done);
+        });
     };
 
-    var locationSuccess = function (pos) {
-        var coordinates = pos.coords;
-        fetchWeatherForCoordinates(coordinates.latitude, coordinates.longitude);
+    var weatherError = function (err, done) {
+        console.log('weather fetch error: ' + err);
+        done({
+            'AppKeyWeather': packWeather(0, 0, now(), true)
+        });
     };
 
-    var weatherError = function (err) {
-        console.log('weather fetch error: ' + err);
-        pebble.sendAppMessage({
-            'AppKeyWeatherFailed': 1
+    // refresh is how long the weather has to stay valid on the watch, in
+    // seconds, for cached weather to be served.
+    var requestWeather = function (refresh, done) {
+        var location = localStorage.getItem("local.WeatherLocation") || environment.location;
+        console.log("got location " + location);
+        if (location) {
+            fetchWeatherForLocation(location, refresh, done);
+        } else {
+            locate(function (latitude, longitude) {
+                fetchWeatherForCoordinates(latitude, longitude, refresh, done);
+            }, function (err) {
+                weatherError(err, done);
+            });
+        }
+    };
+
+    var sendWeather = function (data) {
+        var message = protocol.encodeWeather(protocol.load(), data);
+        console.log('sendAppMessage:', JSON.stringify(message));
+        pebble.sendAppMessage(message, function () {
+            if (message.AppKeyLocation) {
+                localStorage.setItem(LOCATION_SENT, JSON.stringify(message.AppKeyLocation));
+            }
         });
     };
 
+    // The weather only rides along with the ready signal when the watch
+    // announced an inbox large enough for both.
+    var sendReady = function (ready) {
+        var capabilities = protocol.load();
+        if (protocol.fits(capabilities, protocol.encodeWeather(capabilities, ready))) {
+            sendWeather(ready);
+            return;
+        }
+        sendWeather({ 'AppKeyJsReady': 1 });
+        delete ready.AppKeyJsReady;
+        sendWeather(ready);
+    };
+
+    // The last reports are kept along with the settings they were measured
+    // with, so that settings can be compared day by day.
+    var reportEnergy = function (report) {
+        if (!report) {
+            return;
+        }
+        console.log(energy.summary(report));
+        var reports = [];
+        try {
+            reports = JSON.parse(localStorage.getItem(ENERGY_REPORTS)) || [];
+        } catch (e) {
+        }
+        reports.push({ day: report.day, settings: energy.active(report), costs: energy.estimate(report) });
+        localStorage.setItem(ENERGY_REPORTS, JSON.stringify(reports.slice(-ENERGY_REPORTS_KEPT)));
+    };
+
     pebble.addEventListener('appmessage', function (e) {
         var dict = e.payload;
         //console.log('appmessage:', JSON.stringify(dict));
+        if (dict['AppKeyCapabilities'] !== undefined) {
+            protocol.save(protocol.parse(dict['AppKeyCapabilities']));
+        }
         if (dict['AppKeyWeatherRequest']) {
-            var location = localStorage.getItem("local.WeatherLocation");
-            console.log("got location " + location);
-            if (location) {
-                fetchWeatherForLocation(location);
-            } else {
-                window.navigator.geolocation.getCurrentPosition(locationSuccess, weatherError, LOCATION_OPTS);
+            requestWeather(watchRefresh(dict['AppKeyWeatherRequest']), sendWeather);
+        }
+        if (dict['AppKeyTrace']) {
+            console.log(trace.format(dict['AppKeyTrace']));
+        }
+        if (dict['AppKeyEnergy']) {
+            console.log(energy.format(dict['AppKeyEnergy']));
+            reportEnergy(energy.parse(dict['AppKeyEnergy']));
+        }
+    });
+
+    // Weather is fetched, or served from the cache, as soon as the phone side
+    // starts and is sent along with the ready signal, saving the watch a
+    // request round trip. A slow fetch does not hold back the ready signal.
+    pebble.addEventListener('ready', function (e) {
+        var ready = { 'AppKeyJsReady': 1 };
+        // The watch may have lost its location, e.g. after a reinstall.
+        localStorage.removeItem(LOCATION_SENT);
+        var settings = loadSettings();
+        if (settings.AppKeyWeatherEnabled === false) {
+            sendWeather(ready);
+            return;
+        }
+        // The power profile of the watch is not known yet, its refresh rate
+        // is at least the configured one.
+        var refresh = refreshRate(settings);
+        var cached = cachedWeather(refresh);
+        if (cached) {
+            ready.AppKeyWeather = cached.AppKeyWeather;
+            var cache = JSON.parse(localStorage.getItem(WEATHER_CACHE));
+            if (cache.latitude !== undefined) {
+                ready.AppKeyLocation = packLocation(cache.latitude, cache.longitude);
             }
+            sendReady(ready);
+            return;
         }
+        var readySent = false;
+        var readyTimer = setTimeout(function () {
+            readySent = true;
+            sendWeather(ready);
+        }, READY_WEATHER_TIMEOUT);
+        requestWeather(refresh, function (data) {
+            if (readySent) {
+                sendWeather(data);
+                return;
+            }
+            clearTimeout(readyTimer);
+            readySent = true;
+            ready.AppKeyWeather = data.AppKeyWeather;
+            if (data.AppKeyLocation) {
+                ready.AppKeyLocation = data.AppKeyLocation;
+            }
+            sendReady(ready);
+        });
     });
 }(Pebble);
 
-Pebble.addEventListener('ready', function (e) {
-    var data = { 'AppKeyJsReady': 1 };
-    Pebble.sendAppMessage(data);
+// At most four settings messages per second, each carrying only the latest
+// value per key. Settings only reach the watch when the settings page is
+// saved: the page runs in a webview that cannot reach this code before it
+// closes, so there is no live preview while editing.
+var SETTINGS_STREAM_INTERVAL = 250;
+
+var settingsStreamer = Streamer(function (message, ok, fail) {
+    console.log(JSON.stringify(message));
+    Pebble.sendAppMessage(message, ok, function (e) {
+        console.log('Failed to send config data');
+        fail();
+    });
+}, SETTINGS_STREAM_INTERVAL);
+
+// The watch lost the settings it was last synced with, e.g. it fell back to
+// the defaults: the delta of the next save would miss the unchanged ones, so
+// they are all sent again.
+Pebble.addEventListener('appmessage', function (e) {
+    var checksum = e.payload['AppKeyConfigChecksum'];
+    if (checksum === undefined || !settings.watchConfigDiffers(checksum)) {
+        return;
+    }
+    var message = settings.delta(settings.loadLastSynced(), null);
+    console.log('Watch settings differ from the last sync, sending them all');
+    message["AppKeyConfig"] = 1;
+    settingsStreamer.push(message);
 });
 
+// Benchmark builds push a fixed config once the watch is ready, as if it was
+// saved from the settings page.
+if (environment.benchmark) {
+    Pebble.addEventListener('ready', function (e) {
+        setTimeout(function () {
+            var message = JSON.parse(JSON.stringify(environment.benchmark.config));
+            message["AppKeyConfig"] = 1;
+            settingsStreamer.push(message, function () {
+                console.log('Sent benchmark config to Pebble');
+            });
+        }, environment.benchmark.configDelay);
+    });
+}
+
 Pebble.addEventListener('showConfiguration', function (e) {
     Pebble.openURL(clay.generateUrl());
 });
@@ -181,14 +452,21 @@ Pebble.addEventListener('webviewclosed', function (e) {
 
     // Get the keys and values from each config item
     var dict = clay.getSettings(e.response, false);
+    var locationChanged = false;
+
+    // Not a setting: asks the watch to dump its event trace to this log, once.
+    var traceRequested = dict.AppKeyTrace && dict.AppKeyTrace.value &&
+        protocol.supports(protocol.load(), protocol.FEATURES.TRACE);
+    delete dict.AppKeyTrace;
+    settings.resetToggle('AppKeyTrace');
 
     for (var key in dict) {
-        console.log(key);
         // HACK: Cheat the system so that persistent keys are still saved on by Clay. 
         // Set local storage for easy access but are not sent over to device
         if (key.substring(0, "local.".length) === "local.") {
-            console.log("getting rid of " + key);
-            localStorage.setItem(key, dict[key].value.trim());
+            var value = dict[key].value.trim();
+            locationChanged = locationChanged || localStorage.getItem(key) !== value;
+            localStorage.setItem(key, value);
             delete dict[key];
             continue;
         }
@@ -197,20 +475,26 @@ Pebble.addEventListener('webviewclosed', function (e) {
         }
     }
 
-    dict["AppKeyConfig"] = 1;
-
-    console.log(JSON.stringify(dict));
-
-
     var dictConverted = Clay.prepareSettingsForAppMessage(dict);
 
-    console.log(JSON.stringify(dictConverted));
+    // Only the settings that changed since the last successful sync are sent,
+    // unless the watch predates delta config and expects every key.
+    var deltaConfig = protocol.supports(protocol.load(), protocol.FEATURES.DELTA_CONFIG);
+    var message = deltaConfig ? settings.delta(dictConverted, settings.loadLastSynced())
+        : JSON.parse(JSON.stringify(dictConverted));
+    if (traceRequested) {
+        settingsStreamer.push({ 'AppKeyTrace': 1 });
+    }
+    if (!message && !locationChanged) {
+        console.log('Settings unchanged, nothing to send');
+        return;
+    }
+    message = message || {};
+    message["AppKeyConfig"] = 1;
 
     // Send settings values to watch side
-    Pebble.sendAppMessage(dictConverted, function (e) {
+    settingsStreamer.push(message, function () {
         console.log('Sent config data to Pebble');
-
-    }, function (e) {
-        console.log('Failed to send config data');
+        settings.saveLastSynced(dictConverted);
     });
 });
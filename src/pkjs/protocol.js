@@ -0,0 +1,99 @@
+"use strict";
+
+// Mirrors ProtocolFeature in minimalin.c. Watches that never announced their
+// capabilities only understand the per-key tuples.
+var FEATURES = {
+    PACKED_WEATHER: 1 << 0,
+    DELTA_CONFIG: 1 << 1,
+    LOCATION: 1 << 2,
+    TRACE: 1 << 3,
+    CONFIG_CHECKSUM: 1 << 4
+};
+
+var CAPABILITIES = 'watchCapabilities';
+
+var LEGACY = { version: 0, features: 0, inboxSize: 0 };
+
+// AppKeyCapabilities is version << 24 | features << 16 | inbox size.
+var parse = function (value) {
+    return {
+        version: (value >>> 24) & 0xff,
+        features: (value >>> 16) & 0xff,
+        inboxSize: value & 0xffff
+    };
+};
+
+var load = function () {
+    try {
+        return JSON.parse(localStorage.getItem(CAPABILITIES)) || LEGACY;
+    } catch (e) {
+        return LEGACY;
+    }
+};
+
+var save = function (capabilities) {
+    localStorage.setItem(CAPABILITIES, JSON.stringify(capabilities));
+};
+
+var supports = function (capabilities, feature) {
+    return (capabilities.features & feature) !== 0;
+};
+
+// Serialized dictionary size: a count byte, then a 7 byte header per tuple.
+var dictSize = function (message) {
+    var size = 1;
+    for (var key in message) {
+        var value = message[key];
+        size += 7;
+        if (Array.isArray(value)) {
+            size += value.length;
+        } else if (typeof value === 'string') {
+            size += value.length + 1;
+        } else {
+            size += 4;
+        }
+    }
+    return size;
+};
+
+var fits = function (capabilities, message) {
+    return !capabilities.inboxSize || dictSize(message) <= capabilities.inboxSize;
+};
+
+var signed8 = function (value) {
+    return value > 127 ? value - 256 : value;
+};
+
+// Rewrites a weather message built with the packed AppKeyWeather payload for
+// a watch that only knows the per-key weather tuples.
+var encodeWeather = function (capabilities, message) {
+    var encoded = {};
+    for (var key in message) {
+        if (key === 'AppKeyLocation' && !supports(capabilities, FEATURES.LOCATION)) {
+            continue;
+        }
+        if (key === 'AppKeyWeather' && !supports(capabilities, FEATURES.PACKED_WEATHER)) {
+            var weather = message[key];
+            if (weather[3]) {
+                encoded.AppKeyWeatherFailed = 1;
+            } else {
+                encoded.AppKeyWeatherIcon = weather[1];
+                encoded.AppKeyWeatherTemperature = signed8(weather[2]);
+            }
+            continue;
+        }
+        encoded[key] = message[key];
+    }
+    return encoded;
+};
+
+module.exports = {
+    FEATURES: FEATURES,
+    parse: parse,
+    load: load,
+    save: save,
+    supports: supports,
+    dictSize: dictSize,
+    fits: fits,
+    encodeWeather: encodeWeather
+};
@@ -0,0 +1,110 @@
+"use strict";
+
+// Keeps at most one in-flight request per kind. Every request gets a deadline
+// and a newer request of the same kind cancels the one it supersedes, whose
+// callbacks are then never called.
+var RequestManager = function (createRequest) {
+    var inflight = {};
+    var nextId = 1;
+
+    createRequest = createRequest || function () {
+        return new XMLHttpRequest();
+    };
+
+    var cancel = function (kind) {
+        var request = inflight[kind];
+        if (!request) {
+            return;
+        }
+        delete inflight[kind];
+        clearTimeout(request.timer);
+        if (request.abort) {
+            request.abort();
+        }
+    };
+
+    // start(resolve, reject) begins the work and may return a function that
+    // aborts it.
+    var run = function (kind, deadline, start, onSuccess, onError) {
+        cancel(kind);
+        var id = nextId++;
+        var request = { id: id };
+        var finish = function (callback, value) {
+            if (!inflight[kind] || inflight[kind].id !== id) {
+                return;
+            }
+            delete inflight[kind];
+            clearTimeout(request.timer);
+            callback(value);
+        };
+        inflight[kind] = request;
+        request.timer = setTimeout(function () {
+            var abort = request.abort;
+            finish(onError, kind + " timed out after " + deadline + " ms");
+            if (abort) {
+                abort();
+            }
+        }, deadline);
+        request.abort = start(function (value) {
+            finish(onSuccess, value);
+        }, function (err) {
+            finish(onError, err);
+        });
+    };
+
+    var get = function (kind, url, deadline, onSuccess, onError) {
+        run(kind, deadline, function (resolve, reject) {
+            var req = createRequest();
+            req.open('GET', url, true);
+            req.onload = function () {
+                if (req.status === 200) {
+                    resolve(req.responseText);
+                } else {
+                    reject(kind + " error: status " + req.status);
+                }
+            };
+            req.onerror = function () {
+                reject(kind + " error: request failed");
+            };
+            req.send(null);
+            return function () {
+                req.onload = null;
+                req.onerror = null;
+                req.abort();
+            };
+        }, onSuccess, onError);
+    };
+
+    // A response of the wrong shape throws in onSuccess, once the deadline is
+    // already cleared, so that is reported as an error too.
+    var getJson = function (kind, url, deadline, onSuccess, onError) {
+        get(kind, url, deadline, function (responseText) {
+            var response;
+            try {
+                response = JSON.parse(responseText);
+            } catch (e) {
+                onError(kind + " error: invalid response");
+                return;
+            }
+            try {
+                onSuccess(response);
+            } catch (e) {
+                onError(kind + " error: unexpected response, " + e.message);
+            }
+        }, onError);
+    };
+
+    var pending = function (kind) {
+        return !!inflight[kind];
+    };
+
+    return {
+        run: run,
+        get: get,
+        getJson: getJson,
+        cancel: cancel,
+        pending: pending
+    };
+};
+
+module.exports = RequestManager;
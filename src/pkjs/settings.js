@@ -0,0 +1,131 @@
+"use strict";
+
+// Order of the colors in AppKeyPalette, mirrored by config_palette_updated on
+// the watch.
+var PALETTE_KEYS = [
+    'AppKeyMinuteHandColor',
+    'AppKeyHourHandColor',
+    'AppKeyBackgroundColor',
+    'AppKeyTimeColor',
+    'AppKeyInfoColor'
+];
+
+var LAST_SYNCED = 'lastSyncedSettings';
+var CLAY_SETTINGS = 'clay-settings';
+var SYNCED_CHECKSUM = 'syncedConfigChecksum';
+
+// Flag of an AppKeyConfigChecksum that answers a save, see minimalin.c.
+var CHECKSUM_SAVED = 1 << 16;
+
+// Clay may hand back numeric message keys instead of names.
+var messageKeys = {};
+try {
+    messageKeys = require('message_keys');
+} catch (e) {
+}
+
+var paletteValue = function (settings, key) {
+    return settings[key] !== undefined ? settings[key] : settings[messageKeys[key]];
+};
+
+var isPaletteKey = function (key) {
+    for (var i = 0; i < PALETTE_KEYS.length; i++) {
+        if (key === PALETTE_KEYS[i] || key === String(messageKeys[PALETTE_KEYS[i]])) {
+            return true;
+        }
+    }
+    return false;
+};
+
+// 0xRRGGBB to the watch's 8-bit 0bAARRGGBB color.
+var toGColor8 = function (hex) {
+    return 0xc0 | ((hex >> 22) & 0x3) << 4 | ((hex >> 14) & 0x3) << 2 | ((hex >> 6) & 0x3);
+};
+
+var changedKeys = function (settings, lastSynced) {
+    var changed = [];
+    for (var key in settings) {
+        if (!lastSynced || lastSynced[key] !== settings[key]) {
+            changed.push(key);
+        }
+    }
+    return changed;
+};
+
+// Builds the message for the settings that changed since the last sync, with
+// all colors packed into a single AppKeyPalette tuple whenever one of them
+// changed. Returns null when there is nothing to send.
+var delta = function (settings, lastSynced) {
+    var changed = changedKeys(settings, lastSynced);
+    var message = {};
+    var paletteChanged = false;
+    for (var i = 0; i < changed.length; i++) {
+        var key = changed[i];
+        if (isPaletteKey(key)) {
+            paletteChanged = true;
+        } else {
+            message[key] = settings[key];
+        }
+    }
+    if (paletteChanged) {
+        message.AppKeyPalette = PALETTE_KEYS.map(function (key) {
+            return toGColor8(paletteValue(settings, key) || 0);
+        });
+    }
+    return Object.keys(message).length > 0 ? message : null;
+};
+
+var loadLastSynced = function () {
+    try {
+        return JSON.parse(localStorage.getItem(LAST_SYNCED));
+    } catch (e) {
+        return null;
+    }
+};
+
+var saveLastSynced = function (settings) {
+    localStorage.setItem(LAST_SYNCED, JSON.stringify(settings));
+};
+
+// Takes an AppKeyConfigChecksum from the watch. The checksum that answers a
+// save is the one of the synced settings, any other has to match it. Returns
+// true when the watch holds other settings than the last synced ones, which
+// then have to be synced again in full.
+var watchConfigDiffers = function (value) {
+    var checksum = value & 0xffff;
+    if (value & CHECKSUM_SAVED) {
+        localStorage.setItem(SYNCED_CHECKSUM, String(checksum));
+        return false;
+    }
+    if (loadLastSynced() === null) {
+        return false;
+    }
+    var synced = localStorage.getItem(SYNCED_CHECKSUM);
+    return synced === null || parseInt(synced, 10) !== checksum;
+};
+
+// Turns a toggle of the settings page that asks for something once back off,
+// in the values Clay keeps and shows the next time the page opens, so that
+// later saves do not ask again.
+var resetToggle = function (key) {
+    var stored;
+    try {
+        stored = JSON.parse(localStorage.getItem(CLAY_SETTINGS));
+    } catch (e) {
+        return;
+    }
+    if (stored && stored[key]) {
+        stored[key] = false;
+        localStorage.setItem(CLAY_SETTINGS, JSON.stringify(stored));
+    }
+};
+
+module.exports = {
+    PALETTE_KEYS: PALETTE_KEYS,
+    toGColor8: toGColor8,
+    delta: delta,
+    loadLastSynced: loadLastSynced,
+    saveLastSynced: saveLastSynced,
+    watchConfigDiffers: watchConfigDiffers,
+    resetToggle: resetToggle
+};
@@ -0,0 +1,90 @@
+"use strict";
+
+// Rate limits and coalesces messages to the watch. Only one message is in
+// flight at a time, at most one is sent per interval, and values pushed in the
+// meantime are merged so that only the latest value per key is sent. Failed
+// messages are retried with a growing interval and dropped after MAX_RETRIES.
+var MAX_RETRIES = 4;
+
+var Streamer = function (send, minInterval) {
+    var pending = {};
+    var pendingCallbacks = [];
+    var hasPending = false;
+    var inFlight = false;
+    var lastSent = 0;
+    var timer = null;
+    var retries = 0;
+    var stats = { pushed: 0, sent: 0, coalesced: 0, failed: 0, dropped: 0 };
+
+    var merge = function (values, overwrite) {
+        for (var key in values) {
+            if (pending.hasOwnProperty(key)) {
+                stats.coalesced++;
+                if (!overwrite) {
+                    continue;
+                }
+            }
+            pending[key] = values[key];
+            hasPending = true;
+        }
+    };
+
+    var schedule = function () {
+        if (inFlight || timer || !hasPending) {
+            return;
+        }
+        var interval = Math.max(minInterval, 1) * (1 << retries);
+        var wait = Math.max(0, lastSent + interval - Date.now());
+        timer = setTimeout(flush, wait);
+    };
+
+    var flush = function () {
+        timer = null;
+        var message = pending;
+        var callbacks = pendingCallbacks;
+        pending = {};
+        pendingCallbacks = [];
+        hasPending = false;
+        inFlight = true;
+        lastSent = Date.now();
+        stats.sent++;
+        send(message, function () {
+            inFlight = false;
+            retries = 0;
+            callbacks.forEach(function (callback) {
+                callback();
+            });
+            schedule();
+        }, function () {
+            inFlight = false;
+            stats.failed++;
+            if (retries >= MAX_RETRIES) {
+                retries = 0;
+                stats.dropped++;
+                schedule();
+                return;
+            }
+            retries++;
+            // Newer values pushed while this message was in flight win.
+            merge(message, false);
+            pendingCallbacks = callbacks.concat(pendingCallbacks);
+            schedule();
+        });
+    };
+
+    var push = function (values, onSent) {
+        stats.pushed++;
+        merge(values, true);
+        if (onSent) {
+            pendingCallbacks.push(onSent);
+        }
+        schedule();
+    };
+
+    return {
+        push: push,
+        stats: stats
+    };
+};
+
+module.exports = Streamer;
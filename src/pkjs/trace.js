@@ -0,0 +1,24 @@
+"use strict";
+
+// The watch dumps its event trace as AppKeyTrace chunks: a TraceHeader, then
+// the records (see trace.h). They are written to the phone log as hex, which
+// test/host/replay reads back from the log.
+var LOG_PREFIX = 'trace ';
+
+var hex = function (bytes) {
+    var text = '';
+    for (var i = 0; i < bytes.length; i++) {
+        text += ('0' + (bytes[i] & 0xff).toString(16)).slice(-2);
+    }
+    return text;
+};
+
+// The chunk number and count are the second and third header bytes.
+var format = function (bytes) {
+    return LOG_PREFIX + hex(bytes) + ' (' + (bytes[1] + 1) + '/' + bytes[2] + ')';
+};
+
+module.exports = {
+    hex: hex,
+    format: format
+};
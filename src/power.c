@@ -0,0 +1,27 @@
+#include <pebble.h>
+#include "power.h"
+
+static const PowerPolicy POLICIES[] = {
+    [PowerProfileNormal] = {.animation = true, .steps = true, .refresh_rate_factor = 1},
+    [PowerProfileSaving] = {.animation = false, .steps = true, .refresh_rate_factor = 2},
+    [PowerProfileSleeping] = {.animation = false, .steps = false, .refresh_rate_factor = 4}};
+
+PowerProfile power_profile_select(const BatteryChargeState charge_state, const bool sleeping, const bool quiet_time)
+{
+    if (sleeping)
+    {
+        return PowerProfileSleeping;
+    }
+    const bool battery_low = !charge_state.is_charging && !charge_state.is_plugged &&
+                             charge_state.charge_percent <= POWER_SAVING_BATTERY;
+    if (battery_low || quiet_time)
+    {
+        return PowerProfileSaving;
+    }
+    return PowerProfileNormal;
+}
+
+const PowerPolicy *power_policy(const PowerProfile profile)
+{
+    return &POLICIES[profile];
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <pebble.h>
+
+#define POWER_SAVING_BATTERY 20
+
+typedef enum
+{
+    PowerProfileNormal = 0,
+    PowerProfileSaving,
+    PowerProfileSleeping
+} PowerProfile;
+
+typedef struct
+{
+    bool animation;
+    bool steps;
+    int refresh_rate_factor;
+} PowerPolicy;
+
+PowerProfile power_profile_select(const BatteryChargeState charge_state, const bool sleeping, const bool quiet_time);
+const PowerPolicy *power_policy(const PowerProfile profile);
@@ -3,10 +3,13 @@
 #include "pebble.h"
 #include "quadrant.h"
 #include "globals.h"
+#include "tick_points.h"
 
 #define QUADRANT_COUNT 4
-#define POSITIONS_COUNT 4
 #define BLOCK_SIZE GSize(38, 20)
+#define LABEL_SIZE GSize(24, 20)
+#define CORNER_MARGIN 2
+#define SLOTS_ALL (SLOT(POSITIONS_COUNT) - 1)
 #define QUADRANT(blck, prio, pos) \
     (Quadrant) { .block = block, .priority = prio, .position = pos }
 #define BLOCK(quadrants, index) quadrants->quadrants[index]->block
@@ -19,30 +22,103 @@ static GPoint *s_new_info_centers;
 
 static AnimationProgress s_animation_progess = ANIMATION_NORMALIZED_MIN;
 
+// Bumped whenever the slot centers settle somewhere new.
+static int s_centers_generation;
+
 static GRect rect_translate(const GRect rect, const int x, const int y)
 {
     const GPoint origin = rect.origin;
     return (GRect){.origin = GPoint(origin.x + x, origin.y + y), .size = rect.size};
 }
 
+static bool quadrants_animating(void)
+{
+    return s_new_info_centers != NULL && s_animation_progess != ANIMATION_NORMALIZED_MIN;
+}
+
 static GPoint center_for_position(const Position position)
 {
-    if (s_new_info_centers != NULL && s_animation_progess != ANIMATION_NORMALIZED_MIN)
+    if (quadrants_animating())
         return gpoint_lerp_anim(s_info_centers[position], s_new_info_centers[position], s_animation_progess);
     else
         return s_info_centers[position];
 }
 
+static GRect rect_for_position(const Position position)
+{
+    const GRect rect = grect_from_center_and_size(center_for_position(position), BLOCK_SIZE);
+    return rect_translate(rect, 0, 4);
+}
+
 static bool segment_intersect_with_position(const Segment segment, const Position position)
 {
-    GPoint center = center_for_position(position);
-    const GRect rect = grect_from_center_and_size(center, BLOCK_SIZE);
-    return intersect(segment, rect_translate(rect, 0, 4));
+    return intersect(segment, rect_for_position(position));
+}
+
+static bool rect_overlap(const GRect a, const GRect b)
+{
+    return a.origin.x < b.origin.x + b.size.w && b.origin.x < a.origin.x + a.size.w &&
+           a.origin.y < b.origin.y + b.size.h && b.origin.y < a.origin.y + a.size.h;
+}
+
+// Collision masks
+
+static uint8_t hand_mask(const int hand_angle, const int radius)
+{
+    const Segment hand = SEGMENT(g_center, gpoint_on_circle(g_center, hand_angle, radius));
+    uint8_t mask = 0;
+    for (int pos = 0; pos < POSITIONS_COUNT; pos++)
+    {
+        if (segment_intersect_with_position(hand, pos))
+        {
+            mask |= SLOT(pos);
+        }
+    }
+    return mask;
+}
+
+static uint8_t label_mask(const int tick)
+{
+    const GRect label = grect_from_center_and_size(get_time_position(tick, ANIMATION_NORMALIZED_MIN), LABEL_SIZE);
+    uint8_t mask = 0;
+    for (int pos = 0; pos < POSITIONS_COUNT; pos++)
+    {
+        if (rect_overlap(rect_for_position(pos), label))
+        {
+            mask |= SLOT(pos);
+        }
+    }
+    return mask;
+}
+
+// Hands and labels only move over a fixed set of angles and ticks, so which
+// slots they cover is computed once per layout instead of on every update.
+static void quadrants_build_masks(Quadrants *const quadrants)
+{
+    const bool same_center = quadrants->masks_center.x == g_center.x && quadrants->masks_center.y == g_center.y;
+    if (same_center && quadrants->masks_generation == s_centers_generation)
+    {
+        return;
+    }
+    for (int step = 0; step < HOUR_MASK_COUNT; step++)
+    {
+        quadrants->hour_masks[step] = hand_mask(angle(step, HOUR_MASK_COUNT), quadrants->hour_hand_radius);
+    }
+    for (int minute = 0; minute < 60; minute++)
+    {
+        quadrants->minute_masks[minute] = hand_mask(angle(minute, 60), quadrants->minute_hand_radius);
+    }
+    for (int tick = 0; tick < 12; tick++)
+    {
+        quadrants->label_masks[tick] = label_mask(tick);
+    }
+    quadrants->masks_center = g_center;
+    quadrants->masks_generation = s_centers_generation;
 }
 
 static void quadrants_move_quadrant(Quadrants *const quadrants, const Index index, const Position position)
 {
-    if (index >= POSITIONS_COUNT)
+    if (index >= QUADRANT_COUNT)
         return;
 
     Quadrant *const quadrant = quadrants->quadrants[index];
@@ -59,6 +135,12 @@ static void quadrants_swap(Quadrants *quadrants, const Index first, const Index
     quadrants_move_quadrant(quadrants, second, first_position);
 }
 
+static bool quadrants_active(const Quadrants *const quadrants, const Index index)
+{
+    const TextBlock *const block = BLOCK(quadrants, index);
+    return (text_block_get_ready(block) && text_block_get_visible(block)) || text_block_get_enabled(block);
+}
+
 static bool quadrants_takeover_quadrant(Quadrants *const quadrants, const Index index, const Position position)
 {
     if (index >= QUADRANT_COUNT)
@@ -72,8 +154,7 @@ static bool quadrants_takeover_quadrant(Quadrants *const quadrants, const Index
             continue;
         }
         const bool has_higher_priority = PRIORITY(quadrants, index_to_takeover) >= PRIORITY(quadrants, index);
-        const TextBlock *const block = BLOCK(quadrants, index_to_takeover);
-        if (has_higher_priority && ((text_block_get_ready(block) && text_block_get_visible(block)) || text_block_get_enabled(block)))
+        if (has_higher_priority && quadrants_active(quadrants, index_to_takeover))
         {
             return false;
         }
@@ -84,18 +165,23 @@ static bool quadrants_takeover_quadrant(Quadrants *const quadrants, const Index
     return true;
 }
 
-static bool time_intersect_with_position(Quadrants *const quadrants, const tm *const time, const Position pos)
+// While the unobstructed area animates the slots move every frame and the
+// masks do not apply.
+static bool time_intersect_with_position(Quadrants *const quadrants, const TimeState *const time, const Position pos)
 {
-    const int hour_handle = angle_hour(time, true);
-    const Segment hour_hand = SEGMENT(g_center, gpoint_on_circle(g_center, hour_handle, quadrants->hour_hand_radius));
-    const int minute_angle = angle_minute(time);
-    const Segment minute_hand = SEGMENT(g_center, gpoint_on_circle(g_center, minute_angle, quadrants->minute_hand_radius));
+    if (!quadrants_animating())
+    {
+        const uint8_t mask = quadrants->hour_masks[time->hour_step] | quadrants->minute_masks[time->local.tm_min];
+        return (mask & SLOT(pos)) != 0;
+    }
+    const Segment hour_hand = SEGMENT(g_center, gpoint_on_circle(g_center, time->hour_angle, quadrants->hour_hand_radius));
+    const Segment minute_hand = SEGMENT(g_center, gpoint_on_circle(g_center, time->minute_angle, quadrants->minute_hand_radius));
     return segment_intersect_with_position(hour_hand, pos) || segment_intersect_with_position(minute_hand, pos);
 }
 
-static bool quadrants_try_takeover_quadrant_in_order(Quadrants *const quadrants, const Index index, const tm *const time, const Position order[POSITIONS_COUNT], const bool check_intersect)
+static bool quadrants_try_takeover_quadrant_in_order(Quadrants *const quadrants, const Index index, const TimeState *const time, const Position order[FOUR], const bool check_intersect)
 {
-    for (int index_pos = 0; index_pos < POSITIONS_COUNT; index_pos++)
+    for (int index_pos = 0; index_pos < FOUR; index_pos++)
     {
         const Position pos = order[index_pos];
         if (check_intersect && time_intersect_with_position(quadrants, time, pos))
@@ -110,11 +196,11 @@ static bool quadrants_try_takeover_quadrant_in_order(Quadrants *const quadrants,
     return false;
 }
 
-static void quadrants_try_takeover_quadrant(Quadrants *const quadrants, const Index index, const tm *const time)
+static void quadrants_try_takeover_quadrant(Quadrants *const quadrants, const Index index, const TimeState *const time)
 {
-    Position order[POSITIONS_COUNT] = {North, South, East, West};
-    const int hour_mod_12 = time->tm_hour % 12;
-    const int min_fifth = time->tm_min / 5;
+    Position order[FOUR] = {North, South, East, West};
+    const int hour_mod_12 = time->hour_mod_12;
+    const int min_fifth = time->minute_tick;
     const bool hour_at_3 = hour_mod_12 == 3;
     const bool hour_at_9 = hour_mod_12 == 9;
     const bool min_at_3 = min_fifth == 3;
@@ -139,6 +225,74 @@ static void quadrants_try_takeover_quadrant(Quadrants *const quadrants, const In
     quadrants_try_takeover_quadrant_in_order(quadrants, index, time, order, false);
 }
 
+// A slot outside of the slot set is worse than a hand over a block, which is
+// worse than a block next to the time labels.
+static int position_cost(Quadrants *const quadrants, const TimeState *const time, const Position pos)
+{
+    if ((quadrants->slots & SLOT(pos)) == 0)
+    {
+        return 8;
+    }
+    if (time_intersect_with_position(quadrants, time, pos))
+    {
+        return 4;
+    }
+    const uint8_t labels = quadrants->label_masks[time->hour_mod_12] | quadrants->label_masks[time->minute_tick];
+    return (labels & SLOT(pos)) != 0 ? 2 : 0;
+}
+
+// A block only moves when a slot costs less than staying where it is,
+// counting the move itself: one for an empty or inactive slot, two for a
+// slot held by a lower priority block, which gets swapped. Blocks are solved
+// in priority order and each one looks at every slot once, so an update costs
+// at most blocks * slots mask lookups. Corners come first as no hand ever
+// reaches them.
+static void quadrants_keep_quadrant(Quadrants *const quadrants, const Index index, const TimeState *const time)
+{
+#ifdef PBL_ROUND
+    static const Position ORDER[POSITIONS_COUNT] = {North, South, East, West};
+#else
+    static const Position ORDER[POSITIONS_COUNT] = {NorthEast, NorthWest, SouthEast, SouthWest, North, South, East, West};
+#endif
+    const int stay_cost = position_cost(quadrants, time, POS(quadrants, index));
+    if (stay_cost == 0)
+    {
+        return;
+    }
+    int best_cost = stay_cost;
+    Position best_position = POS(quadrants, index);
+    for (int index_pos = 0; index_pos < POSITIONS_COUNT; index_pos++)
+    {
+        const Position pos = ORDER[index_pos];
+        if (pos == POS(quadrants, index) || (quadrants->slots & SLOT(pos)) == 0)
+        {
+            continue;
+        }
+        int move_cost = 1;
+        for (int other = 0; other < quadrants->size; other++)
+        {
+            if (other != index && POS(quadrants, other) == pos && quadrants_active(quadrants, other))
+            {
+                move_cost = PRIORITY(quadrants, other) < PRIORITY(quadrants, index) ? 2 : -1;
+            }
+        }
+        if (move_cost < 0)
+        {
+            continue;
+        }
+        const int cost = position_cost(quadrants, time, pos) + move_cost;
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best_position = pos;
+        }
+    }
+    if (best_position != POS(quadrants, index))
+    {
+        quadrants_takeover_quadrant(quadrants, index, best_position);
+    }
+}
+
 static GPoint *create_centers_for_rect(GPoint *const centers, const GRect area)
 {
     const int width = area.size.w;
@@ -147,22 +301,37 @@ static GPoint *create_centers_for_rect(GPoint *const centers, const GRect area)
     centers[South] = GPoint(area.origin.x + width / 2, area.origin.y + (3 * height) / 4);
     centers[West] = GPoint(area.origin.x + width / 4, area.origin.y + height / 2);
     centers[East] = GPoint(area.origin.x + (3 * width) / 4, area.origin.y + height / 2);
+#ifndef PBL_ROUND
+    const GSize block = BLOCK_SIZE;
+    const int left = area.origin.x + block.w / 2 + CORNER_MARGIN;
+    const int right = area.origin.x + width - block.w / 2 - CORNER_MARGIN;
+    const int top = area.origin.y + block.h / 2 + CORNER_MARGIN;
+    const int bottom = area.origin.y + height - block.h / 2 - CORNER_MARGIN;
+    centers[NorthWest] = GPoint(left, top);
+    centers[NorthEast] = GPoint(right, top);
+    centers[SouthWest] = GPoint(left, bottom);
+    centers[SouthEast] = GPoint(right, bottom);
+#endif
     return centers;
 }
 
 Quadrants *quadrants_create(const GPoint center, const int hour_hand_radius, const int minute_hand_radius, const Layer *const root_layer)
 {
     create_centers_for_rect(s_info_centers, layer_get_unobstructed_bounds(root_layer));
+    s_centers_generation++;
     Quadrants *const quadrants = (Quadrants *)malloc(sizeof(Quadrants));
     quadrants->ready = false;
     g_center = center;
     quadrants->size = 0;
-    for (int i = 0; i < QUADRANT_COUNT; i++)
+    for (int i = 0; i < POSITIONS_COUNT; i++)
     {
         quadrants->free_positions[i] = true;
     }
     quadrants->hour_hand_radius = hour_hand_radius;
     quadrants->minute_hand_radius = minute_hand_radius;
+    quadrants->mode = LayoutGreedy;
+    quadrants->slots = SLOTS_ALL;
+    quadrants->masks_generation = -1;
     for (int i = 0; i < QUADRANT_COUNT; i++)
     {
         quadrants->quadrants[i] = NULL;
@@ -184,7 +353,7 @@ Quadrants *quadrants_destroy(Quadrants *const quadrants)
     return NULL;
 }
 
-TextBlock *quadrants_add_text_block(Quadrants *const quadrants, Layer *const root_layer, const GFont font, const Priority priority, const tm *const time)
+TextBlock *quadrants_add_text_block(Quadrants *const quadrants, Layer *const root_layer, const GFont font, const Priority priority)
 {
     Position position = North;
     for (int pos = 0; pos < POSITIONS_COUNT; pos++)
@@ -217,12 +386,33 @@ TextBlock *quadrants_add_text_block(Quadrants *const quadrants, Layer *const roo
     return block;
 }
 
-void quadrants_update(Quadrants *const quadrants, const tm *const time)
+void quadrants_set_mode(Quadrants *const quadrants, const LayoutMode mode)
+{
+    quadrants->mode = mode;
+}
+
+void quadrants_set_slots(Quadrants *const quadrants, const uint8_t slots)
+{
+    quadrants->slots = slots & SLOTS_ALL;
+}
+
+void quadrants_update(Quadrants *const quadrants, const TimeState *const time)
 {
+    if (!quadrants_animating())
+    {
+        quadrants_build_masks(quadrants);
+    }
     for (int index = 0; index < quadrants->size; index++)
     {
-        const TextBlock *const block = BLOCK(quadrants, index);
-        if ((text_block_get_ready(block) && text_block_get_visible(block)) || text_block_get_enabled(block))
+        if (!quadrants_active(quadrants, index))
+        {
+            continue;
+        }
+        if (quadrants->mode == LayoutStable)
+        {
+            quadrants_keep_quadrant(quadrants, index, time);
+        }
+        else
         {
             quadrants_try_takeover_quadrant(quadrants, index, time);
         }
@@ -254,4 +444,5 @@ void quadrants_unobstructed_area_done(void)
     free(s_new_info_centers);
     s_new_info_centers = NULL;
     s_animation_progess = ANIMATION_NORMALIZED_MIN;
+    s_centers_generation++;
 }
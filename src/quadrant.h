@@ -2,6 +2,7 @@
 
 #include <pebble.h>
 #include "text_block.h"
+#include "time_state.h"
 
 #define FOUR 4
 
@@ -10,9 +11,21 @@ typedef enum
     North = 0,
     South,
     West,
-    East
+    East,
+    NorthWest,
+    NorthEast,
+    SouthWest,
+    SouthEast
 } Position;
 
+// Round screens only have the four edges, the corners of a rectangular
+// screen are out of reach of both hands.
+#define POSITIONS_COUNT PBL_IF_ROUND_ELSE(4, 8)
+#define SLOT(position) (1 << (position))
+#define SLOTS_EDGES (SLOT(North) | SLOT(South) | SLOT(West) | SLOT(East))
+#define SLOTS_CORNERS (SLOT(NorthWest) | SLOT(NorthEast) | SLOT(SouthWest) | SLOT(SouthEast))
+#define HOUR_MASK_COUNT 600
+
 typedef enum
 {
     Tail,
@@ -30,6 +43,15 @@ typedef enum
     Fourth
 } Index;
 
+// Greedy places every block in the first free edge of a fixed order on each
+// update, Stable keeps blocks where they are until a hand or the time labels
+// get in the way and may use every slot of the slot set.
+typedef enum
+{
+    LayoutGreedy,
+    LayoutStable
+} LayoutMode;
+
 typedef struct
 {
     TextBlock *block;
@@ -40,17 +62,28 @@ typedef struct
 typedef struct
 {
     Quadrant *quadrants[4];
-    Position free_positions[4];
+    bool free_positions[POSITIONS_COUNT];
     bool ready;
     int size;
     int hour_hand_radius;
     int minute_hand_radius;
+    LayoutMode mode;
+    uint8_t slots;
+    // Slots covered by the hour hand per hour step, by the minute hand per
+    // minute and by the time label per tick.
+    uint8_t hour_masks[HOUR_MASK_COUNT];
+    uint8_t minute_masks[60];
+    uint8_t label_masks[12];
+    GPoint masks_center;
+    int masks_generation;
 } Quadrants;
 
 Quadrants *quadrants_create(const GPoint center, const int hour_hand_radius, const int minute_hand_radius, const Layer *root_layer);
 Quadrants *quadrants_destroy(Quadrants *const quadrants);
-TextBlock *quadrants_add_text_block(Quadrants *const quadrants, Layer *const root_layer, const GFont font, const Priority priority, const tm *const time);
-void quadrants_update(Quadrants *const quadrants, const tm *const time);
+TextBlock *quadrants_add_text_block(Quadrants *const quadrants, Layer *const root_layer, const GFont font, const Priority priority);
+void quadrants_set_mode(Quadrants *const quadrants, const LayoutMode mode);
+void quadrants_set_slots(Quadrants *const quadrants, const uint8_t slots);
+void quadrants_update(Quadrants *const quadrants, const TimeState *const time);
 
 void quadrants_unobstructed_area_will_change(GRect new_unobstructed_area);
 void quadrants_unobstructed_area_changing(AnimationProgress anim_progress);
@@ -0,0 +1,105 @@
+#include <pebble.h>
+#include "solar.h"
+
+#define MINUTES_PER_DAY 1440
+#define SECONDS_PER_DAY 86400
+// 23.44 degrees, the axial tilt
+#define AXIAL_TILT 4267
+// -0.833 degrees, the sun's center when its upper edge touches the horizon
+#define SUNRISE_ALTITUDE -152
+
+static SolarDay s_solar_day = {.day = -1};
+static Coordinates s_solar_coordinates;
+
+static int32_t angle_from_tenths(const int32_t tenths)
+{
+    return tenths * TRIG_MAX_ANGLE / 3600;
+}
+
+static int32_t isqrt(int64_t value)
+{
+    int64_t root = 0;
+    int64_t bit = (int64_t)1 << 62;
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (int32_t)root;
+}
+
+// Fixed point version of the NOAA approximation, accurate to a few minutes
+// which is plenty to pick the day or night weather icon.
+SolarDay solar_day(const Coordinates *const coordinates, const int day_of_year)
+{
+    const int32_t day = day_of_year + 1;
+    const int32_t declination = -AXIAL_TILT * cos_lookup(TRIG_MAX_ANGLE * (day + 10) / 365) / TRIG_MAX_RATIO;
+    const int32_t b = TRIG_MAX_ANGLE * (day - 81) / 365;
+    // Hundredths of a minute
+    const int32_t equation_of_time = (987 * sin_lookup(2 * b) - 753 * cos_lookup(b) - 150 * sin_lookup(b)) / TRIG_MAX_RATIO;
+    const int32_t noon = MINUTES_PER_DAY / 2 - coordinates->longitude * 4 / 10 - equation_of_time / 100;
+
+    const int32_t latitude = angle_from_tenths(coordinates->latitude);
+    const int64_t sin_product = (int64_t)sin_lookup(latitude) * sin_lookup(declination) / TRIG_MAX_RATIO;
+    const int64_t cos_product = (int64_t)cos_lookup(latitude) * cos_lookup(declination) / TRIG_MAX_RATIO;
+    int32_t half_day;
+    if (cos_product == 0)
+    {
+        half_day = MINUTES_PER_DAY / 4;
+    }
+    else
+    {
+        const int64_t cos_hour_angle = (sin_lookup(SUNRISE_ALTITUDE) - sin_product) * TRIG_MAX_RATIO / cos_product;
+        if (cos_hour_angle >= TRIG_MAX_RATIO)
+        {
+            half_day = 0;
+        }
+        else if (cos_hour_angle <= -TRIG_MAX_RATIO)
+        {
+            half_day = MINUTES_PER_DAY / 2;
+        }
+        else
+        {
+            const int32_t sin_hour_angle = isqrt((int64_t)TRIG_MAX_RATIO * TRIG_MAX_RATIO - cos_hour_angle * cos_hour_angle);
+            const int32_t hour_angle = atan2_lookup(sin_hour_angle >> 2, cos_hour_angle >> 2);
+            half_day = hour_angle * MINUTES_PER_DAY / TRIG_MAX_ANGLE;
+        }
+    }
+    return (SolarDay){.day = day_of_year, .sunrise = noon - half_day, .sunset = noon + half_day};
+}
+
+bool solar_is_day(const Coordinates *const coordinates, const time_t now)
+{
+    const int32_t day = now / SECONDS_PER_DAY;
+    if (day != s_solar_day.day || memcmp(coordinates, &s_solar_coordinates, sizeof(Coordinates)) != 0)
+    {
+        const struct tm *const utc = gmtime(&now);
+        s_solar_day = solar_day(coordinates, utc->tm_yday);
+        s_solar_day.day = day;
+        s_solar_coordinates = *coordinates;
+    }
+    const int32_t day_length = s_solar_day.sunset - s_solar_day.sunrise;
+    if (day_length <= 0)
+    {
+        return false;
+    }
+    if (day_length >= MINUTES_PER_DAY)
+    {
+        return true;
+    }
+    const int32_t minutes = (now % SECONDS_PER_DAY) / 60;
+    const int32_t since_sunrise = ((minutes - s_solar_day.sunrise) % MINUTES_PER_DAY + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+    return since_sunrise < day_length;
+}
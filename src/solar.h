@@ -0,0 +1,22 @@
+#pragma once
+
+#include <pebble.h>
+
+// Coordinates in tenths of a degree, north and east positive.
+typedef struct
+{
+    int16_t latitude;
+    int16_t longitude;
+} Coordinates;
+
+// Sunrise and sunset in minutes after midnight UTC, possibly outside of
+// 0..1440 depending on the longitude.
+typedef struct
+{
+    int32_t day;
+    int16_t sunrise;
+    int16_t sunset;
+} SolarDay;
+
+bool solar_is_day(const Coordinates *const coordinates, const time_t now);
+SolarDay solar_day(const Coordinates *const coordinates, const int day_of_year);
@@ -0,0 +1,67 @@
+#include <pebble.h>
+#include "step_ring.h"
+#include "geometry.h"
+#include "trace.h"
+#include "energy.h"
+
+static void step_ring_update_proc(Layer *layer, GContext *ctx)
+{
+    const StepRing *const step_ring = *(StepRing **)layer_get_data(layer);
+    trace_draw_begin();
+    if (step_ring->segments == 0)
+    {
+        return;
+    }
+    const int end_angle = step_ring->segments >= STEP_RING_SEGMENTS ? TRIG_MAX_ANGLE : angle(step_ring->segments, STEP_RING_SEGMENTS);
+    graphics_context_set_fill_color(ctx, step_ring->color);
+    graphics_fill_radial(ctx, layer_get_bounds(layer), GOvalScaleModeFitCircle, STEP_RING_WIDTH, 0, end_angle);
+    energy_count(EnergyRedrawRing, 1);
+    energy_count(EnergyDrawCalls, 1);
+}
+
+StepRing *step_ring_create(Layer *parent_layer)
+{
+    StepRing *const step_ring = (StepRing *)calloc(1, sizeof(StepRing));
+    Layer *const layer = layer_create_with_data(layer_get_bounds(parent_layer), sizeof(StepRing *));
+    StepRing **data = (StepRing **)layer_get_data(layer);
+    *data = step_ring;
+    step_ring->layer = layer;
+    step_ring->segments = 0;
+    layer_set_update_proc(layer, step_ring_update_proc);
+    layer_add_child(parent_layer, layer);
+    return step_ring;
+}
+
+StepRing *step_ring_destroy(StepRing *step_ring)
+{
+    layer_destroy(step_ring->layer);
+    free(step_ring);
+    return NULL;
+}
+
+// The ring is quantized so that the layer is only redrawn when a new segment
+// gets filled, not on every step count update.
+void step_ring_set_progress(StepRing *step_ring, const int steps, const int goal)
+{
+    int segments = 0;
+    if (goal > 0)
+    {
+        segments = steps >= goal ? STEP_RING_SEGMENTS : steps * STEP_RING_SEGMENTS / goal;
+    }
+    if (segments != step_ring->segments)
+    {
+        step_ring->segments = segments;
+        layer_mark_dirty(step_ring->layer);
+    }
+}
+
+void step_ring_set_color(StepRing *step_ring, const GColor color)
+{
+    step_ring->color = color;
+    layer_mark_dirty(step_ring->layer);
+}
+
+void step_ring_set_visible(StepRing *step_ring, const bool visible)
+{
+    layer_set_hidden(step_ring->layer, !visible);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <pebble.h>
+
+#define STEP_RING_SEGMENTS 60
+#define STEP_RING_WIDTH 3
+
+typedef struct
+{
+    Layer *layer;
+    GColor color;
+    int segments;
+} StepRing;
+
+StepRing *step_ring_create(Layer *parent_layer);
+StepRing *step_ring_destroy(StepRing *step_ring);
+void step_ring_set_progress(StepRing *step_ring, const int steps, const int goal);
+void step_ring_set_color(StepRing *step_ring, const GColor color);
+void step_ring_set_visible(StepRing *step_ring, const bool visible);
@@ -1,12 +1,15 @@
 #include <pebble.h>
 #include "text_block.h"
 #include "geometry.h"
+#include "trace.h"
+#include "energy.h"
 
 // #define DEBUG 1
 
 static void text_block_update_proc(struct Layer *layer, GContext *ctx)
 {
     TextBlock *text_block = *(TextBlock **)layer_get_data(layer);
+    trace_draw_begin();
     text_block->updating = true;
 #ifdef DEBUG
     graphics_context_set_stroke_color(ctx, GColorRed);
@@ -20,6 +23,8 @@ static void text_block_update_proc(struct Layer *layer, GContext *ctx)
     {
         graphics_context_set_text_color(ctx, text_block->color);
         graphics_draw_text(ctx, text_block->text, text_block->font, text_block->frame, GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+        energy_count(EnergyRedrawText, 1);
+        energy_count(EnergyDrawCalls, 1);
     }
     text_block->updating = false;
 }
@@ -64,7 +69,7 @@ TextBlock *text_block_destroy(TextBlock *text_block)
 
 void text_block_set_text(TextBlock *text_block, const char *text, const GColor color)
 {
-    strncpy(text_block->text, text, sizeof(text_block->text));
+    snprintf(text_block->text, sizeof(text_block->text), "%s", text);
     text_block->color = color;
     text_block_mark_dirty(text_block);
 }
@@ -0,0 +1,19 @@
+#include <pebble.h>
+
+#include "geometry.h"
+#include "time_state.h"
+
+void time_state_update(TimeState *const state, const tm *const time)
+{
+    const int hour_mod_12 = time->tm_hour % 12;
+    const bool conflicting = hour_mod_12 == time->tm_min / 5;
+    *state = (TimeState){
+        .local = *time,
+        .hour_mod_12 = hour_mod_12,
+        .minute_tick = time->tm_min / 5,
+        .hour_step = hour_step(time),
+        .hour_angle = angle_hour(time, true),
+        .minute_angle = angle_minute(time),
+        .conflicting = conflicting,
+        .conflicting_north_or_south = conflicting && (hour_mod_12 <= 1 || hour_mod_12 >= 11 || (hour_mod_12 >= 5 && hour_mod_12 <= 7))};
+}
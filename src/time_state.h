@@ -0,0 +1,19 @@
+#pragma once
+
+#include <pebble.h>
+
+// Everything derived from the current time, computed once per tick and only
+// read by the draw procs and the quadrants.
+typedef struct
+{
+    tm local;
+    int hour_mod_12;
+    int minute_tick;
+    int hour_step;
+    int hour_angle;
+    int minute_angle;
+    bool conflicting;
+    bool conflicting_north_or_south;
+} TimeState;
+
+void time_state_update(TimeState *const state, const tm *const time);
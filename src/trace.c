@@ -0,0 +1,105 @@
+#include <pebble.h>
+#include "trace.h"
+
+static TraceRecord s_records[TRACE_SIZE];
+static uint32_t s_recorded;
+static time_t s_start;
+static uint16_t s_start_ms;
+static bool s_paused;
+static bool s_drawing;
+
+static uint32_t trace_now()
+{
+    time_t seconds;
+    uint16_t ms;
+    time_ms(&seconds, &ms);
+    return (uint32_t)(seconds - s_start) * 1000 + ms - s_start_ms;
+}
+
+void trace_init()
+{
+    s_recorded = 0;
+    s_paused = false;
+    s_drawing = false;
+    time_ms(&s_start, &s_start_ms);
+}
+
+void trace_record(const TraceEvent event, const uint8_t detail, const uint16_t value)
+{
+    if (s_paused)
+    {
+        return;
+    }
+    s_records[s_recorded % TRACE_SIZE] = (TraceRecord){.time = trace_now(), .event = event, .detail = detail, .value = value};
+    s_recorded++;
+}
+
+// The whole window is redrawn at once, so a frame is traced from the first
+// update proc of the face to the last one, the center circle.
+void trace_draw_begin()
+{
+    if (!s_drawing)
+    {
+        s_drawing = true;
+        trace_record(TraceEventDrawStart, 0, 0);
+    }
+}
+
+void trace_draw_end()
+{
+    s_drawing = false;
+    trace_record(TraceEventDrawEnd, 0, 0);
+}
+
+// Nothing is recorded while a dump is sent, so that the chunks stay consistent.
+void trace_set_paused(const bool paused)
+{
+    s_paused = paused;
+}
+
+static int16_t utc_offset()
+{
+    const time_t now = time(NULL);
+    const tm local = *localtime(&now);
+    const tm utc = *gmtime(&now);
+    int days = local.tm_yday - utc.tm_yday;
+    if (days > 1)
+    {
+        days = -1;
+    }
+    else if (days < -1)
+    {
+        days = 1;
+    }
+    return days * 24 * 60 + (local.tm_hour - utc.tm_hour) * 60 + local.tm_min - utc.tm_min;
+}
+
+// Fills buffer, TRACE_CHUNK_SIZE bytes, with a chunk of the records from the
+// oldest one on. Returns its size, 0 past the last chunk.
+uint16_t trace_read_chunk(const int chunk, uint8_t *const buffer)
+{
+    const uint32_t count = s_recorded < TRACE_SIZE ? s_recorded : TRACE_SIZE;
+    const uint32_t chunks = (count + TRACE_CHUNK_RECORDS - 1) / TRACE_CHUNK_RECORDS;
+    if (chunk < 0 || (uint32_t)chunk >= chunks)
+    {
+        return 0;
+    }
+    const uint32_t first = chunk * TRACE_CHUNK_RECORDS;
+    const uint32_t chunk_count = count - first < TRACE_CHUNK_RECORDS ? count - first : TRACE_CHUNK_RECORDS;
+    const TraceHeader header = {
+        .version = TRACE_VERSION,
+        .chunk = chunk,
+        .chunks = chunks,
+        .count = chunk_count,
+        .start = s_start,
+        .recorded = s_recorded,
+        .utc_offset = utc_offset()};
+    memcpy(buffer, &header, sizeof(TraceHeader));
+    // The records follow the packed header unaligned.
+    const uint32_t oldest = s_recorded - count;
+    for (uint32_t i = 0; i < chunk_count; i++)
+    {
+        memcpy(buffer + sizeof(TraceHeader) + i * sizeof(TraceRecord), &s_records[(oldest + first + i) % TRACE_SIZE], sizeof(TraceRecord));
+    }
+    return sizeof(TraceHeader) + chunk_count * sizeof(TraceRecord);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <pebble.h>
+
+// Records in RAM, the oldest ones are overwritten. Can be overridden from the
+// environment, like the CONFIG_* defaults.
+#ifndef TRACE_SIZE
+#ifdef PBL_PLATFORM_APLITE
+#define TRACE_SIZE 64
+#else
+#define TRACE_SIZE 256
+#endif
+#endif
+
+#define TRACE_VERSION 1
+#define TRACE_CHUNK_RECORDS 64
+
+typedef enum
+{
+    TraceEventTick = 1,
+    TraceEventBluetooth,
+    TraceEventBattery,
+    TraceEventHealth,
+    TraceEventMessage,
+    TraceEventOutbox,
+    TraceEventUnobstructedWillChange,
+    TraceEventUnobstructedChange,
+    TraceEventUnobstructedDidChange,
+    TraceEventDrawStart,
+    TraceEventDrawEnd
+} TraceEvent;
+
+// What detail and value hold per event:
+//   Tick                        units changed, minute of the day
+//   Bluetooth                   -, connected
+//   Battery                     -, percent | charging << 8 | plugged << 9
+//   Health                      event type, steps today
+//   Message                     -, key of a received tuple
+//   Outbox                      delivered, key
+//   UnobstructedWillChange      -, final unobstructed height
+//   UnobstructedChange          -, animation progress
+//   DrawStart, DrawEnd          -, -
+// A frame is one DrawStart, DrawEnd pair around all the layers it redraws.
+typedef struct
+{
+    uint32_t time;
+    uint8_t event;
+    uint8_t detail;
+    uint16_t value;
+} TraceRecord;
+
+// Starts every chunk of a dump, little endian like the records that follow.
+// start is in seconds since the epoch, record times are milliseconds since start.
+typedef struct
+{
+    uint8_t version;
+    uint8_t chunk;
+    uint8_t chunks;
+    uint8_t count;
+    uint32_t start;
+    uint32_t recorded;
+    int16_t utc_offset;
+} __attribute__((packed)) TraceHeader;
+
+#define TRACE_CHUNK_SIZE (sizeof(TraceHeader) + TRACE_CHUNK_RECORDS * sizeof(TraceRecord))
+
+void trace_init();
+void trace_record(const TraceEvent event, const uint8_t detail, const uint16_t value);
+void trace_draw_begin();
+void trace_draw_end();
+void trace_set_paused(const bool paused);
+uint16_t trace_read_chunk(const int chunk, uint8_t *const buffer);
@@ -13,11 +13,14 @@ const ConfValue CONF_DEFAULTS[CONF_SIZE] = {
   { .key = 2, .type = BoolConf, .value = true }
 };
 
+// Header (version, count, Fletcher-16 checksum), bools, color 0x555555, int 10
+const uint8_t PACKED_CONFIG[] = { CONF_VERSION, 3, 0xe3, 0xb1, 0x04, 0, 0, 0, 0xd5, 10, 0 };
+
 int __wrap_persist_write_data(const uint32_t key, const void * data, const size_t size){
   check_expected(key);
   check_expected_ptr(data);
   check_expected(size);
-  return 1;
+  return size;
 }
 
 int __wrap_persist_read_data(const uint32_t key, void * buffer, const size_t buffer_size){
@@ -54,40 +57,21 @@ static void test_config_load_without_existing_config(void **state){
 }
 
 static void test_config_load_with_existing_config(void **state){
-  ConfValue persisted_value[CONF_SIZE] = {
-    { .key = 2, .type = ColorConf, .value = 0x111111 },
-    { .key = 1, .type = IntConf, .value = 10 },
-    { .key = 0, .type = BoolConf, .value = false }
-  };
-  will_return(__wrap_persist_read_data, CONF_SIZE * sizeof(ConfValue));
-  will_return(__wrap_persist_read_data, persisted_value);
+  will_return(__wrap_persist_read_data, sizeof(PACKED_CONFIG));
+  will_return(__wrap_persist_read_data, PACKED_CONFIG);
   Config * conf = config_load(1, CONF_SIZE, CONF_DEFAULTS);
 
   assert_int_equal(conf->size, CONF_SIZE);
-  ConfValue first_value = conf->data[0];
-  assert_int_equal(first_value.key, 2);
-  assert_int_equal(first_value.type, ColorConf);
-  assert_int_equal(first_value.value.integer, 0x111111);
-  ConfValue second_value = conf->data[1];
-  assert_int_equal(second_value.key, 1);
-  assert_int_equal(second_value.type, IntConf);
-  assert_int_equal(second_value.value.integer, 10);
-  ConfValue third_value = conf->data[2];
-  assert_int_equal(third_value.key, 0);
-  assert_int_equal(third_value.type, BoolConf);
-  assert_false(third_value.value.boolean);
+  assert_int_equal(config_get_int(conf, 0), 0x555555);
+  assert_int_equal(config_get_int(conf, 1), 10);
+  assert_true(config_get_bool(conf, 2));
 
   config_destroy(conf);
 }
 
 static void test_config_load_with_new_default(void **state){
-  ConfValue persisted_value[CONF_SIZE] = {
-    { .key = 2, .type = ColorConf, .value = 0x111111 },
-    { .key = 1, .type = IntConf, .value = 10 },
-    { .key = 0, .type = BoolConf, .value = false }
-  };
-  will_return(__wrap_persist_read_data, CONF_SIZE * sizeof(ConfValue));
-  will_return(__wrap_persist_read_data, persisted_value);
+  will_return(__wrap_persist_read_data, sizeof(PACKED_CONFIG));
+  will_return(__wrap_persist_read_data, PACKED_CONFIG);
   const ConfValue conf_with_extra_value[CONF_SIZE + 1] = {
     { .key = 0, .type = ColorConf, .value = 0xffffff },
     { .key = 1, .type = IntConf, .value = 20 },
@@ -96,19 +80,10 @@ static void test_config_load_with_new_default(void **state){
   };
   Config * conf = config_load(1, CONF_SIZE + 1, conf_with_extra_value);
 
-  assert_int_equal(conf->size, CONF_SIZE);
-  ConfValue first_value = conf->data[0];
-  assert_int_equal(first_value.key, 2);
-  assert_int_equal(first_value.type, ColorConf);
-  assert_int_equal(first_value.value.integer, 0x111111);
-  ConfValue second_value = conf->data[1];
-  assert_int_equal(second_value.key, 1);
-  assert_int_equal(second_value.type, IntConf);
-  assert_int_equal(second_value.value.integer, 10);
-  ConfValue third_value = conf->data[2];
-  assert_int_equal(third_value.key, 0);
-  assert_int_equal(third_value.type, BoolConf);
-  assert_false(third_value.value.boolean);
+  assert_int_equal(conf->size, CONF_SIZE + 1);
+  assert_int_equal(config_get_int(conf, 0), 0x555555);
+  assert_int_equal(config_get_int(conf, 1), 10);
+  assert_true(config_get_bool(conf, 2));
   ConfValue fourth_value = conf->data[3];
   assert_int_equal(fourth_value.key, 3);
   assert_int_equal(fourth_value.type, IntConf);
@@ -117,14 +92,39 @@ static void test_config_load_with_new_default(void **state){
   config_destroy(conf);
 }
 
+static void test_config_load_with_corrupted_config(void **state){
+  uint8_t corrupted[sizeof(PACKED_CONFIG)];
+  memcpy(corrupted, PACKED_CONFIG, sizeof(PACKED_CONFIG));
+  corrupted[sizeof(PACKED_CONFIG) - 2] = 11;
+  will_return(__wrap_persist_read_data, sizeof(corrupted));
+  will_return(__wrap_persist_read_data, corrupted);
+  Config * conf = config_load(1, CONF_SIZE, CONF_DEFAULTS);
+
+  assert_memory_equal(conf->data, CONF_DEFAULTS, CONF_SIZE * sizeof(ConfValue));
+
+  config_destroy(conf);
+}
+
+static void test_config_load_migrates_legacy_config(void **state){
+  // Unversioned layout: int32 key and int32 value pairs, in any order.
+  const int32_t legacy[4] = { 1, 10, 0, 0x555555 };
+  will_return(__wrap_persist_read_data, sizeof(legacy));
+  will_return(__wrap_persist_read_data, legacy);
+  expect_value(__wrap_persist_write_data, key, 1);
+  expect_any(__wrap_persist_write_data, data);
+  expect_value(__wrap_persist_write_data, size, sizeof(PACKED_CONFIG));
+  Config * conf = config_load(1, CONF_SIZE, CONF_DEFAULTS);
+
+  assert_int_equal(config_get_int(conf, 0), 0x555555);
+  assert_int_equal(config_get_int(conf, 1), 10);
+  assert_true(config_get_bool(conf, 2));
+
+  config_destroy(conf);
+}
+
 static void test_config_destroy(void **state){
-  ConfValue persisted_value[CONF_SIZE] = {
-    { .key = 2, .type = ColorConf, .value = 0x111111 },
-    { .key = 1, .type = IntConf, .value = 10 },
-    { .key = 0, .type = BoolConf, .value = false }
-  };
-  will_return(__wrap_persist_read_data, CONF_SIZE * sizeof(ConfValue));
-  will_return(__wrap_persist_read_data, persisted_value);
+  will_return(__wrap_persist_read_data, sizeof(PACKED_CONFIG));
+  will_return(__wrap_persist_read_data, PACKED_CONFIG);
   Config * conf = config_load(1, CONF_SIZE, CONF_DEFAULTS);
 
   assert_null(config_destroy(conf));
@@ -221,18 +221,39 @@ static void test_config_save(void **state){
   Config * conf = config_load(1, CONF_SIZE, CONF_DEFAULTS);
   config_set_int(conf, 1, 5);
   config_set_bool(conf, 2, false);
+  const uint8_t packed[] = { CONF_VERSION, 3, 0x05, 0x0a, 0, 0, 0, 0, 0xff, 5, 0 };
   expect_value(__wrap_persist_write_data, key, 1);
-  int data_size = CONF_SIZE * sizeof(ConfValue);
-  expect_memory(__wrap_persist_write_data, data, conf->data, data_size);
-  expect_value(__wrap_persist_write_data, size, data_size);
-  config_save(conf, 1);
+  expect_memory(__wrap_persist_write_data, data, packed, sizeof(packed));
+  expect_value(__wrap_persist_write_data, size, sizeof(packed));
+  assert_int_equal(config_save(conf, 1), sizeof(packed));
+  config_destroy(conf);
+}
+
+static void test_config_checksum(void **state){
+  will_return(__wrap_persist_read_data, E_DOES_NOT_EXIST);
+  Config * conf = config_load(1, CONF_SIZE, CONF_DEFAULTS);
+  const uint16_t defaults = config_checksum(conf);
+  config_set_int(conf, 1, 5);
+  assert_int_not_equal(config_checksum(conf), defaults);
+  config_set_int(conf, 1, 20);
+  assert_int_equal(config_checksum(conf), defaults);
   config_destroy(conf);
 }
 
+static void test_config_hex_from_gcolor8(void **state){
+  assert_int_equal(config_hex_from_gcolor8(0xc0), 0x000000);
+  assert_int_equal(config_hex_from_gcolor8(0xff), 0xffffff);
+  assert_int_equal(config_hex_from_gcolor8(0xf0), 0xff0000);
+  assert_int_equal(config_hex_from_gcolor8(0xd5), 0x555555);
+}
+
 int main(void){
   const struct CMUnitTest tests[] = {
     cmocka_unit_test(test_config_load_without_existing_config),
     cmocka_unit_test(test_config_load_with_existing_config),
+    cmocka_unit_test(test_config_load_with_new_default),
+    cmocka_unit_test(test_config_load_with_corrupted_config),
+    cmocka_unit_test(test_config_load_migrates_legacy_config),
     cmocka_unit_test(test_config_destroy),
     cmocka_unit_test(test_config_set_int_incorrect_key),
     cmocka_unit_test(test_config_set_int_correct_key),
@@ -245,6 +266,8 @@ int main(void){
     cmocka_unit_test(test_config_get_bool_correct_key),
     cmocka_unit_test(test_config_get_bool_incorrect_key),
     cmocka_unit_test(test_config_save),
+    cmocka_unit_test(test_config_checksum),
+    cmocka_unit_test(test_config_hex_from_gcolor8),
   };
   return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,167 @@
+// The watchface and what the host programs that drive it share: minimalin.c
+// is part of their translation unit, so that they can call its handlers, and
+// launches start from name=value settings.
+
+#pragma once
+
+#define main minimalin_main
+#include "../../src/minimalin.c"
+#undef main
+
+#if defined(PBL_PLATFORM_EMERY)
+#define PLATFORM "emery"
+#elif defined(PBL_ROUND)
+#define PLATFORM "chalk"
+#elif defined(PBL_PLATFORM_APLITE)
+#define PLATFORM "aplite"
+#elif defined(PBL_PLATFORM_DIORITE)
+#define PLATFORM "diorite"
+#else
+#define PLATFORM "basalt"
+#endif
+
+// Messenger stand-in: nothing reaches the phone on the host.
+
+Messenger *messenger_create(const int32_t size, MessengerCallback callback, const Message *messages)
+{
+    return (Messenger *)calloc(1, sizeof(Messenger));
+}
+
+Messenger *messenger_destroy(Messenger *messenger)
+{
+    free(messenger);
+    return NULL;
+}
+
+void messenger_set_outbox_callback(Messenger *messenger, MessengerOutboxCallback callback)
+{
+}
+
+bool messenger_send(Messenger *messenger, const uint32_t key, const int32_t value)
+{
+    return false;
+}
+
+bool messenger_send_once(Messenger *messenger, const uint32_t key, const int32_t value)
+{
+    return false;
+}
+
+bool messenger_send_data(Messenger *messenger, const uint32_t key, const uint8_t *data, const uint16_t size)
+{
+    return false;
+}
+
+// Settings
+
+typedef struct
+{
+    const char *name;
+    ConfigKey key;
+} ConfigSetting;
+
+static const ConfigSetting SETTINGS[] = {
+    {"minute_color", ConfigKeyMinuteHandColor},
+    {"hour_color", ConfigKeyHourHandColor},
+    {"background", ConfigKeyBackgroundColor},
+    {"date_color", ConfigKeyDateColor},
+    {"time_color", ConfigKeyTimeColor},
+    {"info_color", ConfigKeyInfoColor},
+    {"refresh", ConfigKeyRefreshRate},
+    {"unit", ConfigKeyTemperatureUnit},
+    {"bt_icon", ConfigKeyBluetoothIcon},
+    {"weather", ConfigKeyWeatherEnabled},
+    {"rainbow", ConfigKeyRainbowMode},
+    {"date", ConfigKeyDateDisplayed},
+    {"vibrate", ConfigKeyVibrateOnTheHour},
+    {"health", ConfigKeyHealthEnabled},
+    {"battery_at", ConfigKeyBatteryDisplayedAt},
+    {"quiet_visible", ConfigKeyQuietTimeVisible},
+    {"animation", ConfigKeyAnimationEnabled},
+    {"ring", ConfigKeyStepRingEnabled}};
+
+#define SETTINGS_COUNT (sizeof(SETTINGS) / sizeof(ConfigSetting))
+
+// Applies one name=value to the config or to the host services, false for
+// an unknown name.
+static bool apply_setting(Config *const config, Weather *const weather, const char *const setting)
+{
+    char name[32];
+    const char *const equal = strchr(setting, '=');
+    if (equal == NULL || equal - setting >= (long)sizeof(name))
+    {
+        return false;
+    }
+    memcpy(name, setting, equal - setting);
+    name[equal - setting] = '\0';
+    const char *const text = equal + 1;
+    const int32_t value = (int32_t)strtol(text, NULL, 0);
+    for (unsigned int i = 0; i < SETTINGS_COUNT; i++)
+    {
+        if (strcmp(SETTINGS[i].name, name) == 0)
+        {
+            config_set_int(config, SETTINGS[i].key, value);
+            return true;
+        }
+    }
+    if (strcmp(name, "steps") == 0)
+        host_watch.steps = value;
+    else if (strcmp(name, "battery") == 0)
+        host_watch.battery = value;
+    else if (strcmp(name, "connected") == 0)
+        host_watch.connected = value;
+    else if (strcmp(name, "quiet") == 0)
+        host_watch.quiet_time = value;
+    else if (strcmp(name, "24h") == 0)
+        host_watch.clock_24h = value;
+    else if (strcmp(name, "temp") == 0)
+        weather->temperature = value;
+    else if (strcmp(name, "icon") == 0)
+        weather->icon = text[0];
+    else if (strcmp(name, "weather_failed") == 0)
+        weather->failed = value;
+    else
+        return false;
+    return true;
+}
+
+// Stores the settings where the face reads them at launch.
+static bool prepare_watch(const char *const settings, const time_t now)
+{
+    host_persist_reset();
+    host_timers_reset();
+    host_watch = (HostWatch){.now = now, .connected = true, .battery = 100, .average_steps = 8000};
+    Weather weather = {.version = WEATHER_VERSION, .icon = 'a', .temperature = 0, .failed = false, .timestamp = now};
+    bool has_weather = false;
+    Config *const config = config_load(PersistKeyConfig, CONF_SIZE, CONF_DEFAULTS);
+    config_set_int(config, ConfigKeyAnimationEnabled, false);
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", settings);
+    for (char *setting = strtok(buffer, " "); setting != NULL; setting = strtok(NULL, " "))
+    {
+        if (!apply_setting(config, &weather, setting))
+        {
+            fprintf(stderr, "unknown setting %s\n", setting);
+            config_destroy(config);
+            return false;
+        }
+        has_weather |= strncmp(setting, "temp=", 5) == 0 || strncmp(setting, "weather_failed=", 15) == 0;
+    }
+    config_save(config, PersistKeyConfig);
+    config_destroy(config);
+    if (has_weather)
+    {
+        persist_write_data(PersistKeyWeather, &weather, sizeof(Weather));
+    }
+    return true;
+}
+
+static void join_settings(char *const buffer, const size_t size, char **const settings, const int count)
+{
+    buffer[0] = '\0';
+    for (int i = 0; i < count; i++)
+    {
+        strncat(buffer, settings[i], size - strlen(buffer) - 2);
+        strcat(buffer, " ");
+    }
+}
@@ -0,0 +1,633 @@
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <png.h>
+#include <pebble.h>
+
+const char *host_resources = "../../resources";
+
+struct GContext
+{
+    HostFrame *frame;
+    GPoint offset;
+    GRect clip;
+    GColor stroke_color;
+    GColor fill_color;
+    GColor text_color;
+    uint8_t stroke_width;
+};
+
+struct HostFont
+{
+    FT_Library library;
+    FT_Face face;
+    int ascender;
+};
+
+// Pixels
+
+// The black and white displays keep what is closer to white than to black.
+static GColor8 display_color(const GColor8 color)
+{
+#ifdef PBL_BW
+    const int luminance = 2 * color.r + 5 * color.g + color.b;
+    return luminance >= 12 ? GColorWhite : GColorBlack;
+#else
+    return color;
+#endif
+}
+
+static bool clip_contains(const GRect clip, const int x, const int y)
+{
+    return x >= clip.origin.x && y >= clip.origin.y &&
+           x < clip.origin.x + clip.size.w && y < clip.origin.y + clip.size.h;
+}
+
+static void put_pixel(GContext *ctx, const int x, const int y, const GColor8 color)
+{
+    const int frame_x = x + ctx->offset.x;
+    const int frame_y = y + ctx->offset.y;
+    if (color.a == 0 || !clip_contains(ctx->clip, frame_x, frame_y))
+    {
+        return;
+    }
+    ctx->frame->pixels[frame_y * ctx->frame->size.w + frame_x] = display_color(color);
+}
+
+static GRect grect_clip(const GRect rect, const GRect clip)
+{
+    const int left = rect.origin.x > clip.origin.x ? rect.origin.x : clip.origin.x;
+    const int top = rect.origin.y > clip.origin.y ? rect.origin.y : clip.origin.y;
+    const int rect_right = rect.origin.x + rect.size.w;
+    const int clip_right = clip.origin.x + clip.size.w;
+    const int rect_bottom = rect.origin.y + rect.size.h;
+    const int clip_bottom = clip.origin.y + clip.size.h;
+    const int right = rect_right < clip_right ? rect_right : clip_right;
+    const int bottom = rect_bottom < clip_bottom ? rect_bottom : clip_bottom;
+    if (right <= left || bottom <= top)
+    {
+        return GRect(left, top, 0, 0);
+    }
+    return GRect(left, top, right - left, bottom - top);
+}
+
+// Context
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color)
+{
+    ctx->stroke_color = color;
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color)
+{
+    ctx->fill_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color)
+{
+    ctx->text_color = color;
+}
+
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width)
+{
+    ctx->stroke_width = stroke_width;
+}
+
+void graphics_context_set_antialiased(GContext *ctx, bool enable)
+{
+}
+
+// Shapes
+
+static void draw_thin_line(GContext *ctx, GPoint p0, const GPoint p1)
+{
+    const int dx = abs(p1.x - p0.x);
+    const int dy = -abs(p1.y - p0.y);
+    const int step_x = p0.x < p1.x ? 1 : -1;
+    const int step_y = p0.y < p1.y ? 1 : -1;
+    int error = dx + dy;
+    while (true)
+    {
+        put_pixel(ctx, p0.x, p0.y, ctx->stroke_color);
+        if (p0.x == p1.x && p0.y == p1.y)
+        {
+            return;
+        }
+        const int error2 = 2 * error;
+        if (error2 >= dy)
+        {
+            error += dy;
+            p0.x += step_x;
+        }
+        if (error2 <= dx)
+        {
+            error += dx;
+            p0.y += step_y;
+        }
+    }
+}
+
+// Wide lines have round caps: every pixel within half the stroke width of
+// the segment.
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1)
+{
+    if (ctx->stroke_width <= 1)
+    {
+        draw_thin_line(ctx, p0, p1);
+        return;
+    }
+    const int radius = (ctx->stroke_width + 1) / 2;
+    const int left = (p0.x < p1.x ? p0.x : p1.x) - radius;
+    const int right = (p0.x > p1.x ? p0.x : p1.x) + radius;
+    const int top = (p0.y < p1.y ? p0.y : p1.y) - radius;
+    const int bottom = (p0.y > p1.y ? p0.y : p1.y) + radius;
+    const int64_t seg_x = p1.x - p0.x;
+    const int64_t seg_y = p1.y - p0.y;
+    const int64_t length2 = seg_x * seg_x + seg_y * seg_y;
+    // Compared in units of 1/4 pixel squared so that odd widths stay exact.
+    const int64_t max_distance = (int64_t)ctx->stroke_width * ctx->stroke_width;
+    for (int y = top; y <= bottom; y++)
+    {
+        for (int x = left; x <= right; x++)
+        {
+            const int64_t rel_x = x - p0.x;
+            const int64_t rel_y = y - p0.y;
+            int64_t distance;
+            const int64_t dot = rel_x * seg_x + rel_y * seg_y;
+            if (length2 == 0 || dot <= 0)
+            {
+                distance = 4 * (rel_x * rel_x + rel_y * rel_y);
+            }
+            else if (dot >= length2)
+            {
+                const int64_t end_x = x - p1.x;
+                const int64_t end_y = y - p1.y;
+                distance = 4 * (end_x * end_x + end_y * end_y);
+            }
+            else
+            {
+                const int64_t cross = rel_x * seg_y - rel_y * seg_x;
+                distance = 4 * cross * cross / length2;
+            }
+            if (distance <= max_distance)
+            {
+                put_pixel(ctx, x, y, ctx->stroke_color);
+            }
+        }
+    }
+}
+
+void graphics_draw_rect(GContext *ctx, GRect rect)
+{
+    const int right = rect.origin.x + rect.size.w - 1;
+    const int bottom = rect.origin.y + rect.size.h - 1;
+    for (int x = rect.origin.x; x <= right; x++)
+    {
+        put_pixel(ctx, x, rect.origin.y, ctx->stroke_color);
+        put_pixel(ctx, x, bottom, ctx->stroke_color);
+    }
+    for (int y = rect.origin.y; y <= bottom; y++)
+    {
+        put_pixel(ctx, rect.origin.x, y, ctx->stroke_color);
+        put_pixel(ctx, right, y, ctx->stroke_color);
+    }
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, uint32_t corner_mask)
+{
+    for (int y = rect.origin.y; y < rect.origin.y + rect.size.h; y++)
+    {
+        for (int x = rect.origin.x; x < rect.origin.x + rect.size.w; x++)
+        {
+            put_pixel(ctx, x, y, ctx->fill_color);
+        }
+    }
+}
+
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius)
+{
+    const int limit = radius * radius + radius;
+    for (int dy = -radius; dy <= radius; dy++)
+    {
+        for (int dx = -radius; dx <= radius; dx++)
+        {
+            if (dx * dx + dy * dy <= limit)
+            {
+                put_pixel(ctx, p.x + dx, p.y + dy, ctx->fill_color);
+            }
+        }
+    }
+}
+
+// A ring of inset_thickness inside the circle fitted in rect, clockwise from
+// noon between the two angles.
+void graphics_fill_radial(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, uint16_t inset_thickness,
+                          int32_t angle_start, int32_t angle_end)
+{
+    const int diameter = rect.size.w < rect.size.h ? rect.size.w : rect.size.h;
+    // Centers and radii in half pixels.
+    const int center_x2 = 2 * rect.origin.x + rect.size.w - 1;
+    const int center_y2 = 2 * rect.origin.y + rect.size.h - 1;
+    const int outer2 = diameter;
+    const int inner2 = diameter - 2 * inset_thickness;
+    for (int y = rect.origin.y; y < rect.origin.y + rect.size.h; y++)
+    {
+        for (int x = rect.origin.x; x < rect.origin.x + rect.size.w; x++)
+        {
+            const int dx2 = 2 * x - center_x2;
+            const int dy2 = 2 * y - center_y2;
+            const int distance2 = dx2 * dx2 + dy2 * dy2;
+            if (distance2 > outer2 * outer2 || distance2 < inner2 * inner2)
+            {
+                continue;
+            }
+            // Clockwise from noon, the way trig angles go on the watch.
+            const int32_t pixel_angle = atan2_lookup((int16_t)dx2, (int16_t)-dy2);
+            if (pixel_angle >= angle_start && pixel_angle < angle_end)
+            {
+                put_pixel(ctx, x, y, ctx->fill_color);
+            }
+        }
+    }
+}
+
+// Resources
+
+static bool resource_exists(const char *path)
+{
+    FILE *const file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    fclose(file);
+    return true;
+}
+
+// Picks the most specific variant, the way the SDK resolves ~platform and
+// ~color or ~bw tags.
+static void resource_path(char *path, const size_t size, const char *name, const char *extension)
+{
+#if defined(PBL_PLATFORM_EMERY)
+    static const char *const TAGS[] = {"~emery", PBL_IF_COLOR_ELSE("~color", "~bw"), ""};
+#elif defined(PBL_ROUND)
+    static const char *const TAGS[] = {"~chalk", "~round", "~color", ""};
+#else
+    static const char *const TAGS[] = {"~rect", PBL_IF_COLOR_ELSE("~color", "~bw"), ""};
+#endif
+    for (unsigned int i = 0; i < sizeof(TAGS) / sizeof(TAGS[0]); i++)
+    {
+        snprintf(path, size, "%s/%s%s.%s", host_resources, name, TAGS[i], extension);
+        if (resource_exists(path))
+        {
+            return;
+        }
+    }
+}
+
+ResHandle resource_get_handle(uint32_t resource_id)
+{
+    return resource_id;
+}
+
+GFont fonts_load_custom_font(ResHandle handle)
+{
+    char path[256];
+    resource_path(path, sizeof(path), "fonts/nupe", "ttf");
+    GFont font = (GFont)calloc(1, sizeof(struct HostFont));
+    if (FT_Init_FreeType(&font->library) || FT_New_Face(font->library, path, 0, &font->face))
+    {
+        fprintf(stderr, "cannot load font %s\n", path);
+        exit(2);
+    }
+    FT_Set_Pixel_Sizes(font->face, 0, 23);
+    font->ascender = (int)(font->face->size->metrics.ascender >> 6);
+    return font;
+}
+
+void fonts_unload_custom_font(GFont font)
+{
+    FT_Done_Face(font->face);
+    FT_Done_FreeType(font->library);
+    free(font);
+}
+
+// Text
+
+static uint32_t utf8_next(const char **text)
+{
+    const uint8_t *bytes = (const uint8_t *)*text;
+    uint32_t codepoint = bytes[0];
+    int length = 1;
+    if ((codepoint & 0xe0) == 0xc0 && bytes[1])
+    {
+        codepoint = (codepoint & 0x1f) << 6 | (bytes[1] & 0x3f);
+        length = 2;
+    }
+    else if ((codepoint & 0xf0) == 0xe0 && bytes[1] && bytes[2])
+    {
+        codepoint = (codepoint & 0x0f) << 12 | (bytes[1] & 0x3f) << 6 | (bytes[2] & 0x3f);
+        length = 3;
+    }
+    *text += length;
+    return codepoint;
+}
+
+static int text_width(const GFont font, const char *text)
+{
+    int width = 0;
+    while (*text)
+    {
+        if (FT_Load_Char(font->face, utf8_next(&text), FT_LOAD_TARGET_MONO) == 0)
+        {
+            width += (int)(font->face->glyph->advance.x >> 6);
+        }
+    }
+    return width;
+}
+
+// Glyphs are rendered without antialiasing like the fonts of the SDK, on a
+// single line from the top of the box.
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes)
+{
+    if (font == NULL)
+    {
+        return;
+    }
+    const int width = text_width(font, text);
+    int pen_x = box.origin.x;
+    if (alignment == GTextAlignmentCenter)
+    {
+        pen_x += (box.size.w - width) / 2;
+    }
+    else if (alignment == GTextAlignmentRight)
+    {
+        pen_x += box.size.w - width;
+    }
+    const int baseline = box.origin.y + font->ascender;
+    const GContext saved = *ctx;
+    ctx->clip = grect_clip(GRect(box.origin.x + ctx->offset.x, box.origin.y + ctx->offset.y, box.size.w, box.size.h), ctx->clip);
+    while (*text)
+    {
+        if (FT_Load_Char(font->face, utf8_next(&text), FT_LOAD_RENDER | FT_LOAD_TARGET_MONO) != 0)
+        {
+            continue;
+        }
+        const FT_GlyphSlot glyph = font->face->glyph;
+        const FT_Bitmap *const bitmap = &glyph->bitmap;
+        for (unsigned int row = 0; row < bitmap->rows; row++)
+        {
+            const uint8_t *const line = bitmap->buffer + row * bitmap->pitch;
+            for (unsigned int column = 0; column < bitmap->width; column++)
+            {
+                if (line[column / 8] & (0x80 >> (column % 8)))
+                {
+                    put_pixel(ctx, pen_x + glyph->bitmap_left + column, baseline - glyph->bitmap_top + row, ctx->text_color);
+                }
+            }
+        }
+        pen_x += (int)(glyph->advance.x >> 6);
+    }
+    *ctx = saved;
+}
+
+// Bitmaps
+
+static uint8_t color_level(const uint8_t value)
+{
+    return (uint8_t)((value * 3 + 127) / 255);
+}
+
+static GColor8 *png_load(const char *path, GSize *size)
+{
+    png_image image = {0};
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&image, path))
+    {
+        return NULL;
+    }
+    image.format = PNG_FORMAT_RGBA;
+    uint8_t *const rgba = (uint8_t *)malloc(PNG_IMAGE_SIZE(image));
+    if (!png_image_finish_read(&image, NULL, rgba, 0, NULL))
+    {
+        free(rgba);
+        return NULL;
+    }
+    const int count = image.width * image.height;
+    GColor8 *const pixels = (GColor8 *)malloc(count * sizeof(GColor8));
+    for (int i = 0; i < count; i++)
+    {
+        const uint8_t *const pixel = rgba + 4 * i;
+        pixels[i] = (GColor8){.r = color_level(pixel[0]), .g = color_level(pixel[1]), .b = color_level(pixel[2]), .a = color_level(pixel[3])};
+    }
+    free(rgba);
+    *size = GSize(image.width, image.height);
+    return pixels;
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id)
+{
+    char path[256];
+    resource_path(path, sizeof(path), "images/rainbow_hand", "png");
+    GBitmap *const bitmap = (GBitmap *)calloc(1, sizeof(GBitmap));
+    bitmap->pixels = png_load(path, &bitmap->size);
+    if (bitmap->pixels == NULL)
+    {
+        fprintf(stderr, "cannot load bitmap %s\n", path);
+        exit(2);
+    }
+    return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap)
+{
+    free(bitmap->pixels);
+    free(bitmap);
+}
+
+// Rotated bitmaps
+
+static void rot_bitmap_layer_update_proc(Layer *layer, GContext *ctx)
+{
+    const RotBitmapLayer *const rot = (RotBitmapLayer *)layer;
+    const GBitmap *const bitmap = rot->bitmap;
+    const int32_t sin_angle = sin_lookup(rot->angle);
+    const int32_t cos_angle = cos_lookup(rot->angle);
+    const GRect bounds = layer_get_bounds(layer);
+    for (int y = 0; y < bounds.size.h; y++)
+    {
+        for (int x = 0; x < bounds.size.w; x++)
+        {
+            // Back from the screen to the bitmap: a rotation by -angle.
+            const int32_t dx = x - rot->dest_ic.x;
+            const int32_t dy = y - rot->dest_ic.y;
+            const int32_t src_x = rot->src_ic.x + (int32_t)(((int64_t)dx * cos_angle + (int64_t)dy * sin_angle + TRIG_MAX_RATIO / 2) >> 16);
+            const int32_t src_y = rot->src_ic.y + (int32_t)(((int64_t)dy * cos_angle - (int64_t)dx * sin_angle + TRIG_MAX_RATIO / 2) >> 16);
+            if (src_x < 0 || src_y < 0 || src_x >= bitmap->size.w || src_y >= bitmap->size.h)
+            {
+                continue;
+            }
+            const GColor8 color = bitmap->pixels[src_y * bitmap->size.w + src_x];
+            if (rot->compositing_mode == GCompOpSet && color.a == 0)
+            {
+                continue;
+            }
+            put_pixel(ctx, x, y, (GColor8){.argb = color.argb | 0xc0});
+        }
+    }
+}
+
+static int32_t isqrt(int32_t value)
+{
+    int32_t root = 0;
+    while ((root + 1) * (root + 1) <= value)
+    {
+        root++;
+    }
+    return root;
+}
+
+RotBitmapLayer *rot_bitmap_layer_create(GBitmap *bitmap)
+{
+    RotBitmapLayer *const rot = (RotBitmapLayer *)calloc(1, sizeof(RotBitmapLayer));
+    const GSize size = bitmap->size;
+    const int side = isqrt(size.w * size.w + size.h * size.h) + 1;
+    rot->layer.frame = GRect(0, 0, side, side);
+    rot->layer.unobstructed_bounds = GRect(0, 0, side, side);
+    rot->layer.update_proc = rot_bitmap_layer_update_proc;
+    rot->bitmap = bitmap;
+    rot->src_ic = GPoint(size.w / 2, size.h / 2);
+    rot->dest_ic = GPoint(side / 2, side / 2);
+    rot->compositing_mode = GCompOpAssign;
+    return rot;
+}
+
+void rot_bitmap_layer_destroy(RotBitmapLayer *bitmap)
+{
+    free(bitmap);
+}
+
+void rot_bitmap_set_compositing_mode(RotBitmapLayer *bitmap, GCompOp mode)
+{
+    bitmap->compositing_mode = mode;
+}
+
+// The frame grows so that the bitmap fits at any angle around the new
+// center, as on the watch.
+void rot_bitmap_set_src_ic(RotBitmapLayer *bitmap, GPoint ic)
+{
+    bitmap->src_ic = ic;
+    const int32_t horizontal = ic.x > bitmap->bitmap->size.w - ic.x ? ic.x : abs(bitmap->bitmap->size.w - ic.x);
+    const int32_t vertical = ic.y > bitmap->bitmap->size.h - ic.y ? ic.y : abs(bitmap->bitmap->size.h - ic.y);
+    const int32_t side = isqrt(horizontal * horizontal + vertical * vertical) * 2;
+    bitmap->layer.frame.size = GSize(side, side);
+    bitmap->dest_ic = GPoint(side / 2, side / 2);
+    layer_mark_dirty(&bitmap->layer);
+}
+
+void rot_bitmap_layer_set_angle(RotBitmapLayer *bitmap, int32_t angle)
+{
+    bitmap->angle = angle;
+    layer_mark_dirty(&bitmap->layer);
+}
+
+// Frames
+
+HostFrame *host_frame_create(void)
+{
+    HostFrame *const frame = (HostFrame *)calloc(1, sizeof(HostFrame));
+    frame->size = GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+    frame->pixels = (GColor8 *)calloc(PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT, sizeof(GColor8));
+    return frame;
+}
+
+HostFrame *host_frame_destroy(HostFrame *frame)
+{
+    if (frame != NULL)
+    {
+        free(frame->pixels);
+        free(frame);
+    }
+    return NULL;
+}
+
+// Children draw over their parent, clipped to its frame, each one starting
+// from a fresh drawing state.
+static void render_layer(HostFrame *frame, Layer *layer, const GPoint origin, const GRect clip)
+{
+    if (layer->hidden)
+    {
+        return;
+    }
+    const GPoint layer_origin = GPoint(origin.x + layer->frame.origin.x, origin.y + layer->frame.origin.y);
+    const GRect layer_clip = grect_clip(GRect(layer_origin.x, layer_origin.y, layer->frame.size.w, layer->frame.size.h), clip);
+    if (layer->update_proc != NULL)
+    {
+        GContext ctx = {
+            .frame = frame,
+            .offset = layer_origin,
+            .clip = layer_clip,
+            .stroke_color = GColorBlack,
+            .fill_color = GColorBlack,
+            .text_color = GColorBlack,
+            .stroke_width = 1};
+        layer->update_proc(layer, &ctx);
+    }
+    for (int i = 0; i < layer->child_count; i++)
+    {
+        render_layer(frame, layer->children[i], layer_origin, layer_clip);
+    }
+}
+
+void host_render(HostFrame *frame)
+{
+    const Window *const window = window_stack_get_top_window();
+    if (window == NULL)
+    {
+        return;
+    }
+    const GColor8 background = display_color(window->background_color);
+    for (int i = 0; i < frame->size.w * frame->size.h; i++)
+    {
+        frame->pixels[i] = background;
+    }
+    render_layer(frame, window->root_layer, GPoint(0, 0), GRect(0, 0, frame->size.w, frame->size.h));
+}
+
+// PNG
+
+bool host_png_write(const HostFrame *frame, const char *path)
+{
+    const int count = frame->size.w * frame->size.h;
+    uint8_t *const rgb = (uint8_t *)malloc(3 * count);
+    for (int i = 0; i < count; i++)
+    {
+        const GColor8 color = frame->pixels[i];
+        rgb[3 * i] = color.r * 85;
+        rgb[3 * i + 1] = color.g * 85;
+        rgb[3 * i + 2] = color.b * 85;
+    }
+    png_image image = {0};
+    image.version = PNG_IMAGE_VERSION;
+    image.width = frame->size.w;
+    image.height = frame->size.h;
+    image.format = PNG_FORMAT_RGB;
+    const bool written = png_image_write_to_file(&image, path, 0, rgb, 0, NULL) != 0;
+    free(rgb);
+    return written;
+}
+
+HostFrame *host_png_read(const char *path)
+{
+    GSize size;
+    GColor8 *const pixels = png_load(path, &size);
+    if (pixels == NULL)
+    {
+        return NULL;
+    }
+    HostFrame *const frame = (HostFrame *)calloc(1, sizeof(HostFrame));
+    frame->size = size;
+    frame->pixels = pixels;
+    return frame;
+}
@@ -0,0 +1,606 @@
+#include <math.h>
+#include <stdarg.h>
+#include <pebble.h>
+
+HostWatch host_watch = {
+    .now = 0,
+    .clock_24h = false,
+    .connected = true,
+    .quiet_time = false,
+    .battery = 100,
+    .steps = 0,
+    .average_steps = 8000};
+
+// Geometry
+
+GPoint grect_center_point(const GRect *rect)
+{
+    return GPoint(rect->origin.x + rect->size.w / 2, rect->origin.y + rect->size.h / 2);
+}
+
+GRect grect_inset(GRect rect, int16_t inset)
+{
+    return GRect(rect.origin.x + inset, rect.origin.y + inset, rect.size.w - 2 * inset, rect.size.h - 2 * inset);
+}
+
+// Math
+
+int32_t sin_lookup(int32_t angle)
+{
+    return (int32_t)lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle)
+{
+    return (int32_t)lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t atan2_lookup(int16_t y, int16_t x)
+{
+    double radians = atan2(y, x);
+    if (radians < 0)
+    {
+        radians += 2 * M_PI;
+    }
+    return (int32_t)lround(radians / (2 * M_PI) * TRIG_MAX_ANGLE) % TRIG_MAX_ANGLE;
+}
+
+GPoint gpoint_from_polar(GRect container, GOvalScaleMode scale_mode, int32_t angle)
+{
+    const int16_t size = container.size.w < container.size.h ? container.size.w : container.size.h;
+    const int32_t radius = (size - 1) / 2;
+    const int32_t center_x = container.origin.x + (container.size.w - 1) / 2;
+    const int32_t center_y = container.origin.y + (container.size.h - 1) / 2;
+    return GPoint(center_x + sin_lookup(angle) * radius / TRIG_MAX_RATIO,
+                  center_y - cos_lookup(angle) * radius / TRIG_MAX_RATIO);
+}
+
+// App
+
+void app_event_loop(void)
+{
+}
+
+// Logging, quiet unless HOST_LOG is set
+
+void app_log(uint8_t level, const char *filename, int line, const char *fmt, ...)
+{
+    if (getenv("HOST_LOG") == NULL)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s:%d ", filename, line);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+// Time
+
+#undef time
+
+time_t host_time(time_t *tloc)
+{
+    if (tloc != NULL)
+    {
+        *tloc = host_watch.now;
+    }
+    return host_watch.now;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms)
+{
+    if (tloc != NULL)
+    {
+        *tloc = host_watch.now;
+    }
+    if (out_ms != NULL)
+    {
+        *out_ms = host_watch.now_ms;
+    }
+    return host_watch.now_ms;
+}
+
+time_t time_start_of_today(void)
+{
+    const time_t now = host_watch.now;
+    struct tm day = *localtime(&now);
+    day.tm_hour = 0;
+    day.tm_min = 0;
+    day.tm_sec = 0;
+    return mktime(&day);
+}
+
+bool clock_is_24h_style(void)
+{
+    return host_watch.clock_24h;
+}
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler)
+{
+}
+
+void tick_timer_service_unsubscribe(void)
+{
+}
+
+// Timers
+
+#define TIMER_SLOTS 32
+
+struct AppTimer
+{
+    bool used;
+    int64_t deadline;
+    AppTimerCallback callback;
+    void *data;
+};
+
+static AppTimer s_timers[TIMER_SLOTS];
+
+static int64_t host_now_ms(void)
+{
+    return (int64_t)host_watch.now * 1000 + host_watch.now_ms;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data)
+{
+    for (int i = 0; i < TIMER_SLOTS; i++)
+    {
+        if (!s_timers[i].used)
+        {
+            s_timers[i] = (AppTimer){.used = true, .deadline = host_now_ms() + timeout_ms, .callback = callback, .data = callback_data};
+            return &s_timers[i];
+        }
+    }
+    return NULL;
+}
+
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms)
+{
+    if (timer == NULL || !timer->used)
+    {
+        return false;
+    }
+    timer->deadline = host_now_ms() + new_timeout_ms;
+    return true;
+}
+
+void app_timer_cancel(AppTimer *timer)
+{
+    if (timer != NULL)
+    {
+        timer->used = false;
+    }
+}
+
+void host_timers_reset(void)
+{
+    memset(s_timers, 0, sizeof(s_timers));
+}
+
+// Fires the timers that are due by then in deadline order, each one at its
+// own time, and returns how many fired.
+int host_advance(time_t now, uint16_t now_ms)
+{
+    const int64_t target = (int64_t)now * 1000 + now_ms;
+    int fired = 0;
+    for (;;)
+    {
+        AppTimer *next = NULL;
+        for (int i = 0; i < TIMER_SLOTS; i++)
+        {
+            if (s_timers[i].used && s_timers[i].deadline <= target && (next == NULL || s_timers[i].deadline < next->deadline))
+            {
+                next = &s_timers[i];
+            }
+        }
+        if (next == NULL)
+        {
+            break;
+        }
+        if (next->deadline > host_now_ms())
+        {
+            host_watch.now = next->deadline / 1000;
+            host_watch.now_ms = next->deadline % 1000;
+        }
+        next->used = false;
+        next->callback(next->data);
+        fired++;
+    }
+    host_watch.now = now;
+    host_watch.now_ms = now_ms;
+    return fired;
+}
+
+// Animation
+
+struct Animation
+{
+    const AnimationImplementation *implementation;
+};
+
+Animation *animation_create(void)
+{
+    return (Animation *)calloc(1, sizeof(Animation));
+}
+
+bool animation_set_curve(Animation *animation, AnimationCurve curve)
+{
+    return true;
+}
+
+bool animation_set_delay(Animation *animation, uint32_t delay_ms)
+{
+    return true;
+}
+
+bool animation_set_duration(Animation *animation, uint32_t duration_ms)
+{
+    return true;
+}
+
+bool animation_set_implementation(Animation *animation, const AnimationImplementation *implementation)
+{
+    animation->implementation = implementation;
+    return true;
+}
+
+bool animation_schedule(Animation *animation)
+{
+    if (animation->implementation != NULL && animation->implementation->update != NULL)
+    {
+        animation->implementation->update(animation, ANIMATION_NORMALIZED_MAX);
+    }
+    free(animation);
+    return true;
+}
+
+// Storage, one process lifetime
+
+#define PERSIST_SLOTS 16
+
+typedef struct
+{
+    bool used;
+    uint32_t key;
+    size_t size;
+    uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistSlot;
+
+static PersistSlot s_persist[PERSIST_SLOTS];
+
+static PersistSlot *persist_slot(const uint32_t key, const bool create)
+{
+    PersistSlot *free_slot = NULL;
+    for (int i = 0; i < PERSIST_SLOTS; i++)
+    {
+        if (s_persist[i].used && s_persist[i].key == key)
+        {
+            return &s_persist[i];
+        }
+        if (!s_persist[i].used && free_slot == NULL)
+        {
+            free_slot = &s_persist[i];
+        }
+    }
+    if (create && free_slot != NULL)
+    {
+        free_slot->used = true;
+        free_slot->key = key;
+        return free_slot;
+    }
+    return NULL;
+}
+
+bool persist_exists(const uint32_t key)
+{
+    return persist_slot(key, false) != NULL;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size)
+{
+    const PersistSlot *const slot = persist_slot(key, false);
+    if (slot == NULL)
+    {
+        return E_DOES_NOT_EXIST;
+    }
+    const size_t size = slot->size < buffer_size ? slot->size : buffer_size;
+    memcpy(buffer, slot->data, size);
+    return (int)size;
+}
+
+status_t persist_write_data(const uint32_t key, const void *data, const size_t size)
+{
+    PersistSlot *const slot = persist_slot(key, true);
+    if (slot == NULL)
+    {
+        return -1;
+    }
+    slot->size = size < PERSIST_DATA_MAX_LENGTH ? size : PERSIST_DATA_MAX_LENGTH;
+    memcpy(slot->data, data, slot->size);
+    return (status_t)slot->size;
+}
+
+int32_t persist_read_int(const uint32_t key)
+{
+    int32_t value = 0;
+    persist_read_data(key, &value, sizeof(value));
+    return value;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value)
+{
+    return persist_write_data(key, &value, sizeof(value));
+}
+
+status_t persist_delete(const uint32_t key)
+{
+    PersistSlot *const slot = persist_slot(key, false);
+    if (slot == NULL)
+    {
+        return E_DOES_NOT_EXIST;
+    }
+    slot->used = false;
+    return S_SUCCESS;
+}
+
+void host_persist_reset(void)
+{
+    memset(s_persist, 0, sizeof(s_persist));
+}
+
+// Messages
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key)
+{
+    return NULL;
+}
+
+void app_message_deregister_callbacks(void)
+{
+}
+
+// Services
+
+void battery_state_service_subscribe(BatteryStateHandler handler)
+{
+}
+
+void battery_state_service_unsubscribe(void)
+{
+}
+
+BatteryChargeState battery_state_service_peek(void)
+{
+    return (BatteryChargeState){.charge_percent = host_watch.battery, .is_charging = false, .is_plugged = false};
+}
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler)
+{
+}
+
+void bluetooth_connection_service_unsubscribe(void)
+{
+}
+
+bool connection_service_peek_pebble_app_connection(void)
+{
+    return host_watch.connected;
+}
+
+bool quiet_time_is_active(void)
+{
+    return host_watch.quiet_time;
+}
+
+void vibes_short_pulse(void)
+{
+}
+
+bool health_service_events_subscribe(HealthEventHandler handler, void *context)
+{
+    return true;
+}
+
+bool health_service_events_unsubscribe(void)
+{
+    return true;
+}
+
+HealthValue health_service_sum_today(HealthMetric metric)
+{
+    return host_watch.steps;
+}
+
+// The average day walks at a constant pace.
+HealthValue health_service_sum_averaged(HealthMetric metric, time_t time_start, time_t time_end, HealthServiceTimeScope scope)
+{
+    return (HealthValue)((int64_t)host_watch.average_steps * (time_end - time_start) / (24 * 60 * 60));
+}
+
+HealthActivity health_service_peek_current_activities(void)
+{
+    return HealthActivityNone;
+}
+
+// Layers
+
+Layer *layer_create(GRect frame)
+{
+    return layer_create_with_data(frame, 0);
+}
+
+Layer *layer_create_with_data(GRect frame, size_t data_size)
+{
+    Layer *layer = (Layer *)calloc(1, sizeof(Layer));
+    layer->frame = frame;
+    layer->unobstructed_bounds = GRect(0, 0, frame.size.w, frame.size.h);
+    layer->data = data_size ? calloc(1, data_size) : NULL;
+    return layer;
+}
+
+void layer_destroy(Layer *layer)
+{
+    free(layer->data);
+    free(layer);
+}
+
+void *layer_get_data(const Layer *layer)
+{
+    return layer->data;
+}
+
+GRect layer_get_frame(const Layer *layer)
+{
+    return layer->frame;
+}
+
+void layer_set_frame(Layer *layer, GRect frame)
+{
+    layer->frame = frame;
+}
+
+GRect layer_get_bounds(const Layer *layer)
+{
+    return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+GRect layer_get_unobstructed_bounds(const Layer *layer)
+{
+    return layer->unobstructed_bounds;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc)
+{
+    layer->update_proc = update_proc;
+}
+
+void layer_add_child(Layer *parent, Layer *child)
+{
+    if (parent->child_count < (int)(sizeof(parent->children) / sizeof(Layer *)))
+    {
+        parent->children[parent->child_count++] = child;
+        child->parent = parent;
+    }
+}
+
+static bool s_dirty;
+
+void layer_mark_dirty(Layer *layer)
+{
+    layer->dirty_count++;
+    s_dirty = true;
+}
+
+// Whether the firmware would draw a frame: any layer marked since last time.
+bool host_take_dirty(void)
+{
+    const bool dirty = s_dirty;
+    s_dirty = false;
+    return dirty;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden)
+{
+    layer->hidden = hidden;
+}
+
+bool layer_get_hidden(const Layer *layer)
+{
+    return layer->hidden;
+}
+
+// Windows, a stack of one
+
+static Window *s_top_window;
+static UnobstructedAreaHandlers s_unobstructed_handlers;
+static void *s_unobstructed_context;
+
+Window *window_create(void)
+{
+    Window *const window = (Window *)calloc(1, sizeof(Window));
+    window->root_layer = layer_create(GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT));
+    window->background_color = GColorWhite;
+    return window;
+}
+
+void window_destroy(Window *window)
+{
+    layer_destroy(window->root_layer);
+    free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers)
+{
+    window->handlers = handlers;
+}
+
+void window_stack_push(Window *window, bool animated)
+{
+    s_top_window = window;
+    s_unobstructed_handlers = (UnobstructedAreaHandlers){0};
+    if (window->handlers.load != NULL)
+    {
+        window->handlers.load(window);
+    }
+}
+
+Window *window_stack_remove(Window *window, bool animated)
+{
+    if (window->handlers.unload != NULL)
+    {
+        window->handlers.unload(window);
+    }
+    if (s_top_window == window)
+    {
+        s_top_window = NULL;
+    }
+    return window;
+}
+
+Window *window_stack_get_top_window(void)
+{
+    return s_top_window;
+}
+
+Layer *window_get_root_layer(const Window *window)
+{
+    return window->root_layer;
+}
+
+void window_set_background_color(Window *window, GColor background_color)
+{
+    window->background_color = background_color;
+}
+
+void unobstructed_area_service_subscribe(UnobstructedAreaHandlers handlers, void *context)
+{
+    s_unobstructed_handlers = handlers;
+    s_unobstructed_context = context;
+}
+
+// Plays the obstruction animation of the top window in a number of frames,
+// the way the firmware calls the handlers when the timeline peek shows up.
+void host_change_unobstructed_area(GRect area, int steps)
+{
+    const UnobstructedAreaHandlers handlers = s_unobstructed_handlers;
+    if (handlers.will_change != NULL)
+    {
+        handlers.will_change(area, s_unobstructed_context);
+    }
+    for (int step = 1; step <= steps && handlers.change != NULL; step++)
+    {
+        handlers.change((AnimationProgress)((int64_t)ANIMATION_NORMALIZED_MAX * step / steps), s_unobstructed_context);
+    }
+    if (s_top_window != NULL)
+    {
+        s_top_window->root_layer->unobstructed_bounds = area;
+    }
+    if (handlers.did_change != NULL)
+    {
+        handlers.did_change(s_unobstructed_context);
+    }
+}
@@ -0,0 +1,493 @@
+#pragma once
+
+// Host stand-in for the parts of the Pebble SDK used by the watchface, so it
+// can be compiled, measured and rendered on a computer. The math and the
+// rasterizer follow the firmware closely enough for layout decisions and
+// for pixel comparisons between two host builds, they are not bit exact
+// with the watch.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct tm tm;
+
+// Platform
+
+#if defined(PBL_PLATFORM_APLITE) || defined(PBL_PLATFORM_DIORITE)
+#define PBL_BW 1
+#define PBL_IF_COLOR_ELSE(color, other) (other)
+#else
+#define PBL_COLOR 1
+#define PBL_IF_COLOR_ELSE(color, other) (color)
+#endif
+
+#ifdef PBL_PLATFORM_APLITE
+#define PBL_IF_HEALTH_ELSE(health, other) (other)
+#else
+#define PBL_HEALTH 1
+#define PBL_IF_HEALTH_ELSE(health, other) (health)
+#endif
+
+#ifdef PBL_ROUND
+#define PBL_IF_ROUND_ELSE(round, other) (round)
+#else
+#define PBL_RECT 1
+#define PBL_IF_ROUND_ELSE(round, other) (other)
+#endif
+
+#if defined(PBL_PLATFORM_EMERY)
+#define PBL_DISPLAY_WIDTH 200
+#define PBL_DISPLAY_HEIGHT 228
+#elif defined(PBL_ROUND)
+#define PBL_DISPLAY_WIDTH 180
+#define PBL_DISPLAY_HEIGHT 180
+#else
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#endif
+
+// Geometry
+
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+} GPoint;
+
+typedef struct
+{
+    int16_t w;
+    int16_t h;
+} GSize;
+
+typedef struct
+{
+    GPoint origin;
+    GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+#define GRectZero GRect(0, 0, 0, 0)
+
+GPoint grect_center_point(const GRect *rect);
+GRect grect_inset(GRect rect, int16_t inset);
+
+// Colors
+
+typedef union
+{
+    uint8_t argb;
+    struct
+    {
+        uint8_t b : 2;
+        uint8_t g : 2;
+        uint8_t r : 2;
+        uint8_t a : 2;
+    };
+} GColor8;
+
+typedef GColor8 GColor;
+
+#define GColorFromHEX(hex) ((GColor8){.argb = (uint8_t)(0xc0 | (((hex) >> 22) & 0x3) << 4 | (((hex) >> 14) & 0x3) << 2 | (((hex) >> 6) & 0x3))})
+#define GColorBlack ((GColor8){.argb = 0xc0})
+#define GColorWhite ((GColor8){.argb = 0xff})
+#define GColorRed ((GColor8){.argb = 0xf0})
+#define GColorVividViolet ((GColor8){.argb = 0xf7})
+#define GColorClear ((GColor8){.argb = 0x00})
+#define gcolor_equal(a, b) ((a).argb == (b).argb)
+
+// Math
+
+#define TRIG_MAX_ANGLE 0x10000
+#define TRIG_MAX_RATIO 0xffff
+#define DEG_TO_TRIGANGLE(angle) (((angle) * TRIG_MAX_ANGLE) / 360)
+
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+int32_t atan2_lookup(int16_t y, int16_t x);
+
+typedef enum
+{
+    GOvalScaleModeFitCircle,
+    GOvalScaleModeFillCircle
+} GOvalScaleMode;
+
+GPoint gpoint_from_polar(GRect container, GOvalScaleMode scale_mode, int32_t angle);
+
+// App
+
+void app_event_loop(void);
+
+// Logging
+
+#define APP_LOG_LEVEL_ERROR 1
+#define APP_LOG_LEVEL_WARNING 50
+#define APP_LOG_LEVEL_INFO 100
+#define APP_LOG_LEVEL_DEBUG 200
+#define APP_LOG(level, fmt, ...) app_log(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+
+void app_log(uint8_t level, const char *filename, int line, const char *fmt, ...);
+
+// Time, read from the host clock below instead of the computer's.
+
+typedef enum
+{
+    SECOND_UNIT = 1 << 0,
+    MINUTE_UNIT = 1 << 1,
+    HOUR_UNIT = 1 << 2,
+    DAY_UNIT = 1 << 3,
+    MONTH_UNIT = 1 << 4,
+    YEAR_UNIT = 1 << 5
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+time_t host_time(time_t *tloc);
+#define time(tloc) host_time(tloc)
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+time_t time_start_of_today(void);
+bool clock_is_24h_style(void);
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+// Timers only fire when a program moves the host clock with host_advance.
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer);
+
+// Animation runs to completion as soon as it is scheduled.
+
+typedef uint32_t AnimationProgress;
+
+#define ANIMATION_NORMALIZED_MIN 0
+#define ANIMATION_NORMALIZED_MAX 65535
+
+typedef struct Animation Animation;
+typedef void (*AnimationUpdateImplementation)(Animation *animation, const AnimationProgress progress);
+
+typedef struct
+{
+    void (*setup)(Animation *animation);
+    AnimationUpdateImplementation update;
+    void (*teardown)(Animation *animation);
+} AnimationImplementation;
+
+typedef enum
+{
+    AnimationCurveLinear,
+    AnimationCurveEaseIn,
+    AnimationCurveEaseOut,
+    AnimationCurveEaseInOut
+} AnimationCurve;
+
+Animation *animation_create(void);
+bool animation_set_curve(Animation *animation, AnimationCurve curve);
+bool animation_set_delay(Animation *animation, uint32_t delay_ms);
+bool animation_set_duration(Animation *animation, uint32_t duration_ms);
+bool animation_set_implementation(Animation *animation, const AnimationImplementation *implementation);
+bool animation_schedule(Animation *animation);
+
+// Storage
+
+typedef int32_t status_t;
+
+#define S_SUCCESS 0
+#define E_DOES_NOT_EXIST -10
+#define PERSIST_DATA_MAX_LENGTH 256
+
+bool persist_exists(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+status_t persist_write_data(const uint32_t key, const void *data, const size_t size);
+int32_t persist_read_int(const uint32_t key);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+status_t persist_delete(const uint32_t key);
+void host_persist_reset(void);
+
+// Messages, only the types: the host build uses a messenger stand-in.
+
+typedef enum
+{
+    TUPLE_BYTE_ARRAY = 0,
+    TUPLE_CSTRING = 1,
+    TUPLE_UINT = 2,
+    TUPLE_INT = 3
+} TupleType;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t key;
+    TupleType type : 8;
+    uint16_t length;
+    union
+    {
+        uint8_t data[0];
+        char cstring[0];
+        uint8_t uint8;
+        uint16_t uint16;
+        uint32_t uint32;
+        int8_t int8;
+        int16_t int16;
+        int32_t int32;
+    } value[];
+} Tuple;
+
+typedef struct DictionaryIterator DictionaryIterator;
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+void app_message_deregister_callbacks(void);
+
+// Services
+
+typedef struct
+{
+    uint8_t charge_percent;
+    bool is_charging;
+    bool is_plugged;
+} BatteryChargeState;
+
+typedef void (*BatteryStateHandler)(BatteryChargeState charge);
+typedef void (*BluetoothConnectionHandler)(bool connected);
+
+void battery_state_service_subscribe(BatteryStateHandler handler);
+void battery_state_service_unsubscribe(void);
+BatteryChargeState battery_state_service_peek(void);
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler);
+void bluetooth_connection_service_unsubscribe(void);
+bool connection_service_peek_pebble_app_connection(void);
+bool quiet_time_is_active(void);
+void vibes_short_pulse(void);
+
+typedef enum
+{
+    HealthMetricStepCount
+} HealthMetric;
+
+typedef enum
+{
+    HealthServiceTimeScopeOnce,
+    HealthServiceTimeScopeWeekly,
+    HealthServiceTimeScopeDailyWeekdayOrWeekend,
+    HealthServiceTimeScopeDaily
+} HealthServiceTimeScope;
+
+typedef enum
+{
+    HealthEventSignificantUpdate,
+    HealthEventMovementUpdate,
+    HealthEventSleepUpdate
+} HealthEventType;
+
+typedef enum
+{
+    HealthActivityNone = 0,
+    HealthActivitySleep = 1 << 0,
+    HealthActivityRestfulSleep = 1 << 1
+} HealthActivity;
+
+typedef int32_t HealthValue;
+typedef void (*HealthEventHandler)(HealthEventType event, void *context);
+
+bool health_service_events_subscribe(HealthEventHandler handler, void *context);
+bool health_service_events_unsubscribe(void);
+HealthValue health_service_sum_today(HealthMetric metric);
+HealthValue health_service_sum_averaged(HealthMetric metric, time_t time_start, time_t time_end, HealthServiceTimeScope scope);
+HealthActivity health_service_peek_current_activities(void);
+
+// What the host services report, set by the programs before they run the
+// face.
+typedef struct
+{
+    time_t now;
+    uint16_t now_ms;
+    bool clock_24h;
+    bool connected;
+    bool quiet_time;
+    uint8_t battery;
+    int steps;
+    int average_steps;
+} HostWatch;
+
+extern HostWatch host_watch;
+
+// Layers and drawing
+
+typedef struct GContext GContext;
+typedef struct HostFont *GFont;
+typedef struct Layer Layer;
+
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+struct Layer
+{
+    GRect frame;
+    GRect unobstructed_bounds;
+    bool hidden;
+    int dirty_count;
+    LayerUpdateProc update_proc;
+    Layer *parent;
+    Layer *children[16];
+    int child_count;
+    void *data;
+};
+
+Layer *layer_create(GRect frame);
+Layer *layer_create_with_data(GRect frame, size_t data_size);
+void layer_destroy(Layer *layer);
+void *layer_get_data(const Layer *layer);
+GRect layer_get_frame(const Layer *layer);
+void layer_set_frame(Layer *layer, GRect frame);
+GRect layer_get_bounds(const Layer *layer);
+GRect layer_get_unobstructed_bounds(const Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_mark_dirty(Layer *layer);
+void layer_set_hidden(Layer *layer, bool hidden);
+bool layer_get_hidden(const Layer *layer);
+
+typedef struct
+{
+    void (*will_change)(GRect final_unobstructed_screen_area, void *context);
+    void (*change)(AnimationProgress progress, void *context);
+    void (*did_change)(void *context);
+} UnobstructedAreaHandlers;
+
+void unobstructed_area_service_subscribe(UnobstructedAreaHandlers handlers, void *context);
+
+typedef struct Window Window;
+
+typedef struct
+{
+    void (*load)(Window *window);
+    void (*appear)(Window *window);
+    void (*disappear)(Window *window);
+    void (*unload)(Window *window);
+} WindowHandlers;
+
+struct Window
+{
+    Layer *root_layer;
+    GColor background_color;
+    WindowHandlers handlers;
+};
+
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_stack_push(Window *window, bool animated);
+Window *window_stack_remove(Window *window, bool animated);
+Window *window_stack_get_top_window(void);
+Layer *window_get_root_layer(const Window *window);
+void window_set_background_color(Window *window, GColor background_color);
+
+typedef enum
+{
+    GTextOverflowModeWordWrap,
+    GTextOverflowModeTrailingEllipsis,
+    GTextOverflowModeFill
+} GTextOverflowMode;
+
+typedef enum
+{
+    GTextAlignmentLeft,
+    GTextAlignmentCenter,
+    GTextAlignmentRight
+} GTextAlignment;
+
+typedef enum
+{
+    GCompOpAssign,
+    GCompOpAssignInverted,
+    GCompOpOr,
+    GCompOpAnd,
+    GCompOpClear,
+    GCompOpSet
+} GCompOp;
+
+typedef struct GTextAttributes GTextAttributes;
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width);
+void graphics_context_set_antialiased(GContext *ctx, bool enable);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_rect(GContext *ctx, GRect rect);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, uint32_t corner_mask);
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_fill_radial(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, uint16_t inset_thickness,
+                          int32_t angle_start, int32_t angle_end);
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes);
+
+// Resources are looked up by name in the resources directory.
+
+typedef enum
+{
+    RESOURCE_ID_IMG_RAINBOW_HAND = 1,
+    RESOURCE_ID_FONT_NUPE_23
+} ResourceId;
+
+typedef uint32_t ResHandle;
+
+ResHandle resource_get_handle(uint32_t resource_id);
+GFont fonts_load_custom_font(ResHandle handle);
+void fonts_unload_custom_font(GFont font);
+
+typedef struct
+{
+    GSize size;
+    GColor8 *pixels;
+} GBitmap;
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+void gbitmap_destroy(GBitmap *bitmap);
+
+typedef struct
+{
+    Layer layer;
+    GBitmap *bitmap;
+    GPoint src_ic;
+    GPoint dest_ic;
+    int32_t angle;
+    GCompOp compositing_mode;
+} RotBitmapLayer;
+
+RotBitmapLayer *rot_bitmap_layer_create(GBitmap *bitmap);
+void rot_bitmap_layer_destroy(RotBitmapLayer *bitmap);
+void rot_bitmap_set_compositing_mode(RotBitmapLayer *bitmap, GCompOp mode);
+void rot_bitmap_set_src_ic(RotBitmapLayer *bitmap, GPoint ic);
+void rot_bitmap_layer_set_angle(RotBitmapLayer *bitmap, int32_t angle);
+
+// Host rendering: draws the window on top of the stack into a frame buffer
+// of GColor8 pixels, the size of the display.
+
+typedef struct
+{
+    GSize size;
+    GColor8 *pixels;
+} HostFrame;
+
+extern const char *host_resources;
+
+HostFrame *host_frame_create(void);
+HostFrame *host_frame_destroy(HostFrame *frame);
+void host_render(HostFrame *frame);
+void host_change_unobstructed_area(GRect area, int steps);
+int host_advance(time_t now, uint16_t now_ms);
+void host_timers_reset(void);
+bool host_take_dirty(void);
+bool host_png_write(const HostFrame *frame, const char *path);
+HostFrame *host_png_read(const char *path);
@@ -0,0 +1,124 @@
+// Simulates a day of minute ticks and counts how often the info blocks move
+// between slots with each layout mode and slot set. Covered minutes are
+// checked against the hands directly, not through the collision masks.
+
+#include "../../src/quadrant.c"
+#include "consts.h"
+
+#if defined(PBL_PLATFORM_EMERY)
+#define PLATFORM "emery"
+#define SCREEN GRect(0, 0, 200, 228)
+#elif defined(PBL_ROUND)
+#define PLATFORM "chalk"
+#define SCREEN GRect(0, 0, 180, 180)
+#else
+#define PLATFORM "basalt"
+#define SCREEN GRect(0, 0, 144, 168)
+#endif
+
+#define MINUTES_PER_DAY (24 * 60)
+
+typedef struct
+{
+    int moves;
+    int dirty;
+    int covered;
+} LayoutStats;
+
+static int dirty_count(const Quadrants *const quadrants)
+{
+    int dirty = 0;
+    for (int index = 0; index < quadrants->size; index++)
+    {
+        dirty += BLOCK(quadrants, index)->layer->dirty_count;
+    }
+    return dirty;
+}
+
+static bool covered(const Quadrants *const quadrants, const TimeState *const time, const Position pos)
+{
+    const Segment hour_hand = SEGMENT(g_center, gpoint_on_circle(g_center, time->hour_angle, quadrants->hour_hand_radius));
+    const Segment minute_hand = SEGMENT(g_center, gpoint_on_circle(g_center, time->minute_angle, quadrants->minute_hand_radius));
+    return segment_intersect_with_position(hour_hand, pos) || segment_intersect_with_position(minute_hand, pos);
+}
+
+static LayoutStats simulate(const LayoutMode mode, const uint8_t slots, const int active)
+{
+    static const Priority PRIORITIES[] = {Low, High, Head, Tail};
+    LayoutStats stats = {0};
+    Layer *const root = layer_create(SCREEN);
+    const GRect bounds = layer_get_bounds(root);
+    tick_points_init(&bounds);
+    Quadrants *const quadrants = quadrants_create(grect_center_point(&bounds), HOUR_HAND_RADIUS, MINUTE_HAND_RADIUS, root);
+    quadrants_set_mode(quadrants, mode);
+    quadrants_set_slots(quadrants, slots);
+    TextBlock *blocks[QUADRANT_COUNT];
+    for (int i = 0; i < QUADRANT_COUNT; i++)
+    {
+        blocks[i] = quadrants_add_text_block(quadrants, root, NULL, PRIORITIES[i]);
+        text_block_set_text(blocks[i], i < active ? "00" : "", GColorWhite);
+        text_block_set_enabled(blocks[i], i < active);
+    }
+    TimeState time;
+    tm local = {0};
+    time_state_update(&time, &local);
+    quadrants_update(quadrants, &time);
+    const int dirty_before = dirty_count(quadrants);
+    for (int minute = 1; minute <= MINUTES_PER_DAY; minute++)
+    {
+        local.tm_hour = (minute / 60) % 24;
+        local.tm_min = minute % 60;
+        time_state_update(&time, &local);
+        Position before[QUADRANT_COUNT];
+        for (int index = 0; index < quadrants->size; index++)
+        {
+            before[index] = POS(quadrants, index);
+        }
+        quadrants_update(quadrants, &time);
+        for (int index = 0; index < quadrants->size; index++)
+        {
+            stats.moves += POS(quadrants, index) != before[index];
+            if (quadrants_active(quadrants, index))
+            {
+                stats.covered += covered(quadrants, &time, POS(quadrants, index));
+            }
+        }
+    }
+    stats.dirty = dirty_count(quadrants) - dirty_before;
+    for (int i = 0; i < QUADRANT_COUNT; i++)
+    {
+        text_block_destroy(blocks[i]);
+    }
+    quadrants_destroy(quadrants);
+    layer_destroy(root);
+    return stats;
+}
+
+int main(void)
+{
+    int failures = 0;
+    printf("%-8s %-7s %-7s %-6s %8s %8s %16s\n", "platform", "blocks", "layout", "slots", "moves", "dirty", "covered minutes");
+    for (int active = QUADRANT_COUNT; active >= 2; active--)
+    {
+        const LayoutStats greedy = simulate(LayoutGreedy, SLOTS_EDGES, active);
+        const LayoutStats edges = simulate(LayoutStable, SLOTS_EDGES, active);
+        const LayoutStats all = simulate(LayoutStable, SLOTS_ALL, active);
+        printf("%-8s %-7d %-7s %-6d %8d %8d %16d\n", PLATFORM, active, "greedy", FOUR, greedy.moves, greedy.dirty, greedy.covered);
+        printf("%-8s %-7d %-7s %-6d %8d %8d %16d\n", PLATFORM, active, "stable", FOUR, edges.moves, edges.dirty, edges.covered);
+        if (POSITIONS_COUNT > FOUR)
+        {
+            printf("%-8s %-7d %-7s %-6d %8d %8d %16d\n", PLATFORM, active, "stable", POSITIONS_COUNT, all.moves, all.dirty, all.covered);
+        }
+        if (edges.moves > greedy.moves || edges.covered > greedy.covered)
+        {
+            printf("stable layout regressed with %d blocks\n", active);
+            failures++;
+        }
+        if (all.moves > edges.moves || all.covered > edges.covered)
+        {
+            printf("extra slots regressed with %d blocks\n", active);
+            failures++;
+        }
+    }
+    return failures;
+}
@@ -0,0 +1,267 @@
+// Runs the layout over every minute of the dial for every combination of
+// info blocks, with and without the timeline peek, and checks it against
+// the baseline in golden/<platform>/quadrants.txt. Collisions, moves and
+// intersect() calls may not grow; nanoseconds per update are only reported.
+//
+//   quadrant_verify -c golden       check the baseline
+//   quadrant_verify -w golden       rewrite it after an improvement
+//   quadrant_verify -v ...          one line per block combination
+
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "geometry.h"
+
+static long s_intersect_calls;
+
+static bool counted_intersect(const Segment seg, const GRect frame)
+{
+    s_intersect_calls++;
+    return intersect(seg, frame);
+}
+
+#define intersect counted_intersect
+#include "../../src/quadrant.c"
+#undef intersect
+#include "consts.h"
+
+#if defined(PBL_PLATFORM_EMERY)
+#define PLATFORM "emery"
+#elif defined(PBL_ROUND)
+#define PLATFORM "chalk"
+#else
+#define PLATFORM "basalt"
+#endif
+
+#define SCREEN GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT)
+#define OBSTRUCTION 51
+#define DIAL_MINUTES (12 * 60)
+#define COMBINATIONS (1 << QUADRANT_COUNT)
+
+typedef struct
+{
+    long updates;
+    long hand_collisions;
+    long label_collisions;
+    long moves;
+    long intersect_calls;
+    long overlaps;
+    double nanoseconds;
+} VerifyStats;
+
+static const char *const AREAS[] = {"open", "peek"};
+
+// The blocks of the face, in the order it adds them.
+static const char *const BLOCK_NAMES[QUADRANT_COUNT] = {"date", "steps", "weather", "watch"};
+static const Priority BLOCK_PRIORITIES[QUADRANT_COUNT] = {Low, High, Head, Tail};
+
+static double now_ns(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+static void verify_positions(Quadrants *const quadrants, const TimeState *const time, VerifyStats *const stats)
+{
+    const uint8_t labels = quadrants->label_masks[time->hour_mod_12] | quadrants->label_masks[time->minute_tick];
+    uint8_t taken = 0;
+    for (int index = 0; index < quadrants->size; index++)
+    {
+        if (!quadrants_active(quadrants, index))
+        {
+            continue;
+        }
+        const Position pos = POS(quadrants, index);
+        stats->hand_collisions += time_intersect_with_position(quadrants, time, pos);
+        stats->label_collisions += (labels & SLOT(pos)) != 0;
+        stats->overlaps += (taken & SLOT(pos)) != 0 || (quadrants->slots & SLOT(pos)) == 0;
+        taken |= SLOT(pos);
+    }
+}
+
+static VerifyStats verify(const bool obstructed, const int combination)
+{
+    VerifyStats stats = {0};
+    Layer *const root = layer_create(SCREEN);
+    if (obstructed)
+    {
+        root->unobstructed_bounds = GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT - OBSTRUCTION);
+    }
+    const GRect area = layer_get_unobstructed_bounds(root);
+    tick_points_init(&area);
+    s_intersect_calls = 0;
+    Quadrants *const quadrants = quadrants_create(grect_center_point(&area), HOUR_HAND_RADIUS, MINUTE_HAND_RADIUS, root);
+    quadrants_set_mode(quadrants, LayoutStable);
+    TextBlock *blocks[QUADRANT_COUNT];
+    for (int i = 0; i < QUADRANT_COUNT; i++)
+    {
+        const bool enabled = combination & (1 << i);
+        blocks[i] = quadrants_add_text_block(quadrants, root, NULL, BLOCK_PRIORITIES[i]);
+        text_block_set_text(blocks[i], enabled ? "00" : "", GColorWhite);
+        text_block_set_enabled(blocks[i], enabled);
+    }
+    TimeState time;
+    tm local = {0};
+    for (int minute = 0; minute < DIAL_MINUTES; minute++)
+    {
+        local.tm_hour = minute / 60;
+        local.tm_min = minute % 60;
+        time_state_update(&time, &local);
+        Position before[QUADRANT_COUNT];
+        for (int index = 0; index < quadrants->size; index++)
+        {
+            before[index] = POS(quadrants, index);
+        }
+        const double start = now_ns();
+        quadrants_update(quadrants, &time);
+        stats.nanoseconds += now_ns() - start;
+        stats.updates++;
+        for (int index = 0; index < quadrants->size; index++)
+        {
+            stats.moves += minute > 0 && POS(quadrants, index) != before[index];
+        }
+        verify_positions(quadrants, &time, &stats);
+    }
+    stats.intersect_calls = s_intersect_calls;
+    for (int i = 0; i < QUADRANT_COUNT; i++)
+    {
+        text_block_destroy(blocks[i]);
+    }
+    quadrants_destroy(quadrants);
+    layer_destroy(root);
+    return stats;
+}
+
+static void combination_name(char *const buffer, const size_t size, const int combination)
+{
+    buffer[0] = '\0';
+    for (int i = 0; i < QUADRANT_COUNT; i++)
+    {
+        if (combination & (1 << i))
+        {
+            strncat(buffer, buffer[0] ? "+" : "", size - strlen(buffer) - 1);
+            strncat(buffer, BLOCK_NAMES[i], size - strlen(buffer) - 1);
+        }
+    }
+    if (buffer[0] == '\0')
+    {
+        snprintf(buffer, size, "none");
+    }
+}
+
+static void print_stats(const char *const area, const char *const blocks, const VerifyStats *const stats)
+{
+    printf("%-8s %-5s %-26s %6ld %6ld %6ld %6ld %10ld %8.0f\n", PLATFORM, area, blocks, stats->hand_collisions,
+           stats->label_collisions, stats->moves, stats->overlaps, stats->intersect_calls, stats->nanoseconds / stats->updates);
+}
+
+static void add_stats(VerifyStats *const total, const VerifyStats *const stats)
+{
+    total->updates += stats->updates;
+    total->hand_collisions += stats->hand_collisions;
+    total->label_collisions += stats->label_collisions;
+    total->moves += stats->moves;
+    total->intersect_calls += stats->intersect_calls;
+    total->overlaps += stats->overlaps;
+    total->nanoseconds += stats->nanoseconds;
+}
+
+int main(int argc, char **argv)
+{
+    const char *baseline_dir = NULL;
+    bool write = false;
+    bool verbose = false;
+    int option;
+    while ((option = getopt(argc, argv, "c:w:v")) != -1)
+    {
+        switch (option)
+        {
+        case 'c':
+            baseline_dir = optarg;
+            break;
+        case 'w':
+            baseline_dir = optarg;
+            write = true;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c DIR | -w DIR] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE *baseline = NULL;
+    char path[256];
+    if (baseline_dir != NULL)
+    {
+        snprintf(path, sizeof(path), "%s/%s", baseline_dir, PLATFORM);
+        mkdir(baseline_dir, 0755);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s/%s/quadrants.txt", baseline_dir, PLATFORM);
+        baseline = fopen(path, write ? "w" : "r");
+        if (baseline == NULL)
+        {
+            printf("%s: no %s\n", PLATFORM, path);
+            return 1;
+        }
+    }
+
+    int failures = 0;
+    printf("%-8s %-5s %-26s %6s %6s %6s %6s %10s %8s\n", "platform", "area", "blocks", "hands", "labels", "moves", "errors", "intersect", "ns/upd");
+    for (int area = 0; area < 2; area++)
+    {
+        VerifyStats total = {0};
+        for (int combination = 0; combination < COMBINATIONS; combination++)
+        {
+            const VerifyStats stats = verify(area == 1, combination);
+            char blocks[64];
+            combination_name(blocks, sizeof(blocks), combination);
+            if (verbose)
+            {
+                print_stats(AREAS[area], blocks, &stats);
+            }
+            add_stats(&total, &stats);
+            if (stats.overlaps > 0)
+            {
+                printf("%s %s %s: %ld updates put a block on a taken or disabled slot\n", PLATFORM, AREAS[area], blocks, stats.overlaps);
+                failures++;
+            }
+            if (baseline == NULL)
+            {
+                continue;
+            }
+            if (write)
+            {
+                fprintf(baseline, "%s %s %ld %ld %ld %ld\n", AREAS[area], blocks, stats.hand_collisions,
+                        stats.label_collisions, stats.moves, stats.intersect_calls);
+                continue;
+            }
+            char expected_area[8];
+            char expected_blocks[64];
+            long hands, labels, moves, intersects;
+            const int read = fscanf(baseline, "%7s %63s %ld %ld %ld %ld", expected_area, expected_blocks, &hands, &labels, &moves, &intersects);
+            if (read != 6 || strcmp(expected_area, AREAS[area]) != 0 || strcmp(expected_blocks, blocks) != 0)
+            {
+                printf("%s: %s does not match the block combinations, rewrite it\n", PLATFORM, path);
+                failures++;
+                continue;
+            }
+            if (stats.hand_collisions > hands || stats.label_collisions > labels || stats.moves > moves || stats.intersect_calls > intersects)
+            {
+                printf("%s %s %s regressed: hands %ld > %ld, labels %ld > %ld, moves %ld > %ld or intersect %ld > %ld\n",
+                       PLATFORM, AREAS[area], blocks, stats.hand_collisions, hands, stats.label_collisions, labels,
+                       stats.moves, moves, stats.intersect_calls, intersects);
+                failures++;
+            }
+        }
+        print_stats(AREAS[area], "all", &total);
+    }
+    if (baseline != NULL)
+    {
+        fclose(baseline);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,281 @@
+// Renders the watchface on the host for a time, a set of settings and an
+// obstruction, and checks frames against the golden images of golden/.
+//
+//   render -o frame.png -t 10:08 rainbow=1 steps=4200   one frame
+//   render -c golden -d build/basalt                    check the goldens
+//   render -w golden                                    rewrite them
+//   render -s health=1                                  hash of every minute
+//
+// Settings are config values (see SETTINGS) and what the watch services
+// report. Golden frames are rendered from a fresh launch; the sweep launches
+// once and ticks through twelve hours, the way the watch does, and is kept
+// as one digest per state in golden/<platform>/sweep.txt.
+
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "face.h"
+
+// 2025-03-01, the day of the store screenshots.
+#define RENDER_DAY 1740787200
+#define SWEEP_MINUTES (12 * 60)
+#define OBSTRUCTION_FRAMES 4
+
+// States
+
+typedef struct
+{
+    const char *name;
+    int hour;
+    int minute;
+    int obstruction;
+    const char *settings;
+} RenderState;
+
+static const RenderState GOLDEN_STATES[] = {
+    {"default", 10, 8, 0, "temp=12 icon=b"},
+    {"conflict", 12, 0, 0, "rainbow=1 temp=-3 icon=e"},
+    {"status", 9, 15, 0, "health=1 ring=1 steps=5400 battery=30 battery_at=50 connected=0 quiet=1 unit=1 temp=21 icon=a"},
+    {"obstructed", 3, 40, 51, "health=1 steps=12400 temp=7 icon=c"},
+    {"military", 21, 50, 0, "24h=1 background=0x0000aa time_color=0xffffff info_color=0xffff00 weather_failed=1"}};
+
+#define GOLDEN_STATES_COUNT (sizeof(GOLDEN_STATES) / sizeof(RenderState))
+
+static void obstruct(const int obstruction)
+{
+    if (obstruction > 0)
+    {
+        host_change_unobstructed_area(GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT - obstruction), OBSTRUCTION_FRAMES);
+    }
+}
+
+static bool render_state(const RenderState *const state, HostFrame *const frame)
+{
+    if (!prepare_watch(state->settings, RENDER_DAY + (state->hour * 60 + state->minute) * 60))
+    {
+        return false;
+    }
+    init();
+    obstruct(state->obstruction);
+    host_render(frame);
+    deinit();
+    return true;
+}
+
+// Frames
+
+static uint32_t frame_hash(const HostFrame *const frame, uint32_t hash)
+{
+    for (int i = 0; i < frame->size.w * frame->size.h; i++)
+    {
+        hash = (hash ^ (frame->pixels[i].argb & 0x3f)) * 16777619u;
+    }
+    return hash;
+}
+
+static int frame_diff(const HostFrame *const actual, const HostFrame *const expected, HostFrame *const diff)
+{
+    if (actual->size.w != expected->size.w || actual->size.h != expected->size.h)
+    {
+        return actual->size.w * actual->size.h;
+    }
+    int different = 0;
+    for (int i = 0; i < actual->size.w * actual->size.h; i++)
+    {
+        const bool same = ((actual->pixels[i].argb ^ expected->pixels[i].argb) & 0x3f) == 0;
+        different += !same;
+        diff->pixels[i] = same ? (GColor8){.argb = 0xc0 | ((actual->pixels[i].argb >> 1) & 0x15)} : GColorRed;
+    }
+    return different;
+}
+
+// One digest for twelve hours of minute ticks after a single launch.
+static uint32_t sweep_state(const RenderState *const state, HostFrame *const frame, const bool verbose)
+{
+    uint32_t digest = 2166136261u;
+    if (!prepare_watch(state->settings, RENDER_DAY))
+    {
+        return 0;
+    }
+    init();
+    obstruct(state->obstruction);
+    for (int minute = 0; minute < SWEEP_MINUTES; minute++)
+    {
+        host_watch.now = RENDER_DAY + minute * 60;
+        const time_t now = host_watch.now;
+        tick_handler(localtime(&now), minute % 60 == 0 ? HOUR_UNIT | MINUTE_UNIT : MINUTE_UNIT);
+        host_render(frame);
+        digest = frame_hash(frame, digest);
+        if (verbose)
+        {
+            printf("%02d:%02d %08x\n", minute / 60, minute % 60, frame_hash(frame, 2166136261u));
+        }
+    }
+    deinit();
+    return digest;
+}
+
+static double elapsed_ms(const struct timespec *const start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Goldens
+
+static int check_goldens(const char *const golden_dir, const char *const out_dir, const bool write)
+{
+    char path[512];
+    int failures = 0;
+    HostFrame *frame = host_frame_create();
+    HostFrame *diff = host_frame_create();
+    mkdir(golden_dir, 0755);
+    snprintf(path, sizeof(path), "%s/%s", golden_dir, PLATFORM);
+    mkdir(path, 0755);
+    for (unsigned int i = 0; i < GOLDEN_STATES_COUNT; i++)
+    {
+        const RenderState *const state = &GOLDEN_STATES[i];
+        render_state(state, frame);
+        snprintf(path, sizeof(path), "%s/%s/%s.png", golden_dir, PLATFORM, state->name);
+        if (write)
+        {
+            host_png_write(frame, path);
+            continue;
+        }
+        HostFrame *golden = host_png_read(path);
+        const int different = golden == NULL ? -1 : frame_diff(frame, golden, diff);
+        golden = host_frame_destroy(golden);
+        if (different == 0)
+        {
+            continue;
+        }
+        failures++;
+        printf("%s %s: %s\n", PLATFORM, state->name, different < 0 ? "no golden" : "differs");
+        if (different > 0)
+        {
+            printf("  %d pixels, see %s/%s.png and %s.diff.png\n", different, out_dir, state->name, state->name);
+            snprintf(path, sizeof(path), "%s/%s.diff.png", out_dir, state->name);
+            host_png_write(diff, path);
+        }
+        snprintf(path, sizeof(path), "%s/%s.png", out_dir, state->name);
+        host_png_write(frame, path);
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint32_t digests[GOLDEN_STATES_COUNT];
+    for (unsigned int i = 0; i < GOLDEN_STATES_COUNT; i++)
+    {
+        digests[i] = sweep_state(&GOLDEN_STATES[i], frame, false);
+    }
+    const double sweep_ms = elapsed_ms(&start);
+    snprintf(path, sizeof(path), "%s/%s/sweep.txt", golden_dir, PLATFORM);
+    FILE *file = fopen(path, write ? "w" : "r");
+    for (unsigned int i = 0; i < GOLDEN_STATES_COUNT && file != NULL; i++)
+    {
+        const RenderState *const state = &GOLDEN_STATES[i];
+        if (write)
+        {
+            fprintf(file, "%s %08x\n", state->name, digests[i]);
+            continue;
+        }
+        char name[32];
+        unsigned int expected = 0;
+        if (fscanf(file, "%31s %x", name, &expected) != 2 || strcmp(name, state->name) != 0 || expected != digests[i])
+        {
+            failures++;
+            printf("%s %s: sweep differs, compare render -s -v output at the last good commit\n", PLATFORM, state->name);
+        }
+    }
+    if (file == NULL)
+    {
+        failures++;
+        printf("%s: no %s\n", PLATFORM, path);
+    }
+    else
+    {
+        fclose(file);
+    }
+    const int frames = GOLDEN_STATES_COUNT * SWEEP_MINUTES;
+    printf("%-8s %d goldens, %d swept frames in %.0f ms (%.3f ms per frame)%s\n", PLATFORM, (int)GOLDEN_STATES_COUNT,
+           frames, sweep_ms, sweep_ms / frames, failures ? ", FAILED" : "");
+    host_frame_destroy(frame);
+    host_frame_destroy(diff);
+    return failures;
+}
+
+// Command line
+
+int main(int argc, char **argv)
+{
+    setenv("TZ", "UTC", 1);
+    tzset();
+    const char *output = "frame.png";
+    const char *golden_dir = NULL;
+    const char *out_dir = ".";
+    bool write = false;
+    bool sweep = false;
+    bool verbose = false;
+    RenderState state = {.name = "frame", .hour = 10, .minute = 8};
+    int option;
+    while ((option = getopt(argc, argv, "o:t:u:c:w:d:r:sv")) != -1)
+    {
+        switch (option)
+        {
+        case 'o':
+            output = optarg;
+            break;
+        case 't':
+            sscanf(optarg, "%d:%d", &state.hour, &state.minute);
+            break;
+        case 'u':
+            state.obstruction = atoi(optarg);
+            break;
+        case 'c':
+            golden_dir = optarg;
+            break;
+        case 'w':
+            golden_dir = optarg;
+            write = true;
+            break;
+        case 'd':
+            out_dir = optarg;
+            break;
+        case 'r':
+            host_resources = optarg;
+            break;
+        case 's':
+            sweep = true;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t HH:MM] [-u OBSTRUCTION] [-o PNG | -c DIR | -w DIR | -s [-v]] [-d DIR] [-r RESOURCES] [name=value...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (golden_dir != NULL)
+    {
+        return check_goldens(golden_dir, out_dir, write) ? 1 : 0;
+    }
+    char settings[256];
+    join_settings(settings, sizeof(settings), argv + optind, argc - optind);
+    state.settings = settings;
+    HostFrame *frame = host_frame_create();
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (sweep)
+    {
+        const uint32_t digest = sweep_state(&state, frame, verbose);
+        printf("%s sweep %08x in %.0f ms\n", PLATFORM, digest, elapsed_ms(&start));
+    }
+    else if (!render_state(&state, frame) || !host_png_write(frame, output))
+    {
+        host_frame_destroy(frame);
+        return 1;
+    }
+    host_frame_destroy(frame);
+    return 0;
+}
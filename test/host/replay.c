@@ -0,0 +1,510 @@
+// Feeds an event trace dumped by the watch back through the handlers of the
+// face, in order and at the recorded times, and profiles them.
+//
+//   replay trace.log health=1     profile the replay, with the watch settings
+//   replay -p trace.log           print the records
+//
+// The log is what the phone wrote after "Send Debug Trace on Save", only its
+// "trace <hex>" chunks are read. The trace does not carry the settings, the
+// face launches at the first record with the ones given (see face.h). Timers
+// fire at their deadlines between the records and a frame is drawn whenever
+// a handler marked a layer dirty. The replayed face traces itself as well:
+// apart from the frames, that trace has to match the input.
+
+#include <getopt.h>
+
+#include "face.h"
+
+#define TRACE_LINE_MAX 4096
+
+typedef struct
+{
+    TraceHeader header;
+    int count;
+    TraceRecord *records;
+} Trace;
+
+typedef struct
+{
+    long count;
+    double total_ns;
+    double max_ns;
+} Profile;
+
+static const char *const EVENT_NAMES[] = {
+    [TraceEventTick] = "tick",
+    [TraceEventBluetooth] = "bluetooth",
+    [TraceEventBattery] = "battery",
+    [TraceEventHealth] = "health",
+    [TraceEventMessage] = "message",
+    [TraceEventOutbox] = "outbox",
+    [TraceEventUnobstructedWillChange] = "unob_will",
+    [TraceEventUnobstructedChange] = "unob_change",
+    [TraceEventUnobstructedDidChange] = "unob_did",
+    [TraceEventDrawStart] = "draw_start",
+    [TraceEventDrawEnd] = "draw_end"};
+
+#define EVENT_COUNT (sizeof(EVENT_NAMES) / sizeof(char *))
+
+static bool draw_event(const uint8_t event)
+{
+    return event == TraceEventDrawStart || event == TraceEventDrawEnd;
+}
+
+static const char *event_name(const uint8_t event)
+{
+    return event < EVENT_COUNT && EVENT_NAMES[event] ? EVENT_NAMES[event] : "unknown";
+}
+
+// Reading
+
+static int hex_digit(const char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static int parse_hex(const char *text, uint8_t *const bytes, const int size)
+{
+    int count = 0;
+    while (count < size && hex_digit(text[0]) >= 0 && hex_digit(text[1]) >= 0)
+    {
+        bytes[count++] = hex_digit(text[0]) << 4 | hex_digit(text[1]);
+        text += 2;
+    }
+    return count;
+}
+
+// Chunks are appended in order. A chunk 0 starts a new dump, so the last
+// complete dump of a log is the one replayed.
+static bool trace_add_chunk(Trace *const trace, const uint8_t *const bytes, const int size, bool *const complete)
+{
+    TraceHeader header;
+    if (size < (int)sizeof(TraceHeader))
+    {
+        return false;
+    }
+    memcpy(&header, bytes, sizeof(TraceHeader));
+    if (header.version != TRACE_VERSION || size != (int)(sizeof(TraceHeader) + header.count * sizeof(TraceRecord)))
+    {
+        return false;
+    }
+    if (header.chunk == 0)
+    {
+        trace->count = 0;
+        trace->header = header;
+    }
+    else if (header.chunk != trace->header.chunk + 1 || header.start != trace->header.start)
+    {
+        return false;
+    }
+    trace->header.chunk = header.chunk;
+    trace->records = (TraceRecord *)realloc(trace->records, (trace->count + header.count) * sizeof(TraceRecord));
+    memcpy(trace->records + trace->count, bytes + sizeof(TraceHeader), header.count * sizeof(TraceRecord));
+    trace->count += header.count;
+    *complete = header.chunk + 1 == header.chunks;
+    return true;
+}
+
+static bool trace_load(Trace *const trace, const char *const path)
+{
+    FILE *const file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    Trace current = {0};
+    bool complete = false;
+    bool found = false;
+    char line[TRACE_LINE_MAX];
+    uint8_t bytes[TRACE_LINE_MAX / 2];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        const char *const chunk = strstr(line, "trace ");
+        if (chunk == NULL)
+        {
+            continue;
+        }
+        const int size = parse_hex(chunk + strlen("trace "), bytes, sizeof(bytes));
+        if (!trace_add_chunk(&current, bytes, size, &complete))
+        {
+            fprintf(stderr, "%s: skipping a chunk out of order or of another version\n", path);
+            continue;
+        }
+        if (complete)
+        {
+            free(trace->records);
+            *trace = current;
+            current.records = NULL;
+            current.count = 0;
+            found = true;
+        }
+    }
+    free(current.records);
+    fclose(file);
+    if (!found)
+    {
+        fprintf(stderr, "%s: no complete trace\n", path);
+    }
+    return found;
+}
+
+// Record times are milliseconds since the trace started and wrap after 49
+// days, absolute times never do.
+static int64_t *trace_times(const Trace *const trace)
+{
+    int64_t *const times = (int64_t *)malloc(trace->count * sizeof(int64_t));
+    int64_t wrap = 0;
+    for (int i = 0; i < trace->count; i++)
+    {
+        if (i > 0 && trace->records[i].time < trace->records[i - 1].time)
+        {
+            wrap += (int64_t)1 << 32;
+        }
+        times[i] = (int64_t)trace->header.start * 1000 + trace->records[i].time + wrap;
+    }
+    return times;
+}
+
+// The watch reports its offset to UTC, the replay runs in the same one.
+static void set_timezone(const int utc_offset)
+{
+    const int minutes = utc_offset < 0 ? -utc_offset : utc_offset;
+    char zone[32];
+    snprintf(zone, sizeof(zone), "TRACE%c%02d:%02d", utc_offset < 0 ? '+' : '-', minutes / 60, minutes % 60);
+    setenv("TZ", zone, 1);
+    tzset();
+}
+
+static void print_record(const TraceRecord *const record, const int64_t time)
+{
+    const time_t seconds = time / 1000;
+    const tm local = *localtime(&seconds);
+    printf("%02d:%02d:%02d.%03d %-11s %3d %5d\n", local.tm_hour, local.tm_min, local.tm_sec, (int)(time % 1000),
+           event_name(record->event), record->detail, record->value);
+}
+
+// Replay
+
+static GRect s_replay_area;
+
+// Only the keys are traced, so messages are replayed with the values the
+// face already has: a fresh weather, config effects without a new value.
+static void replay_message(const uint32_t key)
+{
+    switch (key)
+    {
+    case AppKeyJsReady:
+        js_ready_callback(NULL, NULL);
+        break;
+    case AppKeyTrace:
+        trace_requested_callback(NULL, NULL);
+        break;
+    case AppKeyWeather:
+    case AppKeyWeatherTemperature:
+        s_context.weather.failed = false;
+        s_context.weather.timestamp = time(NULL);
+        weather_updated();
+        break;
+    case AppKeyWeatherFailed:
+        weather_failed();
+        break;
+    default:
+        for (unsigned int i = 0; i < CONFIG_MESSAGES_COUNT; i++)
+        {
+            if (CONFIG_MESSAGES[i].app_key == key)
+            {
+                s_config_effects |= CONFIG_MESSAGES[i].effects;
+            }
+        }
+        break;
+    }
+}
+
+static void replay_record(const TraceRecord *const record, const bool message_done)
+{
+    const time_t now = time(NULL);
+    tm local = *localtime(&now);
+    switch (record->event)
+    {
+    case TraceEventTick:
+        tick_handler(&local, record->detail);
+        break;
+    case TraceEventBluetooth:
+        host_watch.connected = record->value;
+        bt_handler(record->value);
+        break;
+    case TraceEventBattery:
+        host_watch.battery = record->value & 0xff;
+        battery_handler((BatteryChargeState){
+            .charge_percent = record->value & 0xff,
+            .is_charging = (record->value >> 8) & 1,
+            .is_plugged = (record->value >> 9) & 1});
+        break;
+    case TraceEventHealth:
+        host_watch.steps = record->value;
+        step_handler(record->detail, &s_context);
+        break;
+    // The messenger stand-in does not trace, the replay does it in its place.
+    case TraceEventMessage:
+        trace_record(TraceEventMessage, 0, record->value);
+        replay_message(record->value);
+        if (message_done)
+        {
+            messenger_callback(NULL);
+        }
+        break;
+    case TraceEventOutbox:
+        trace_record(TraceEventOutbox, record->detail, record->value);
+        outbox_callback(record->value, record->detail);
+        break;
+    case TraceEventUnobstructedWillChange:
+        s_replay_area = GRect(0, 0, PBL_DISPLAY_WIDTH, record->value);
+        unobstructed_area_will_change_handler(s_replay_area, NULL);
+        break;
+    case TraceEventUnobstructedChange:
+        unobstructed_area_change_handler(record->value, NULL);
+        break;
+    case TraceEventUnobstructedDidChange:
+        s_root_layer->unobstructed_bounds = s_replay_area;
+        unobstructed_area_did_change_handler(NULL);
+        break;
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+static void profile_add(Profile *const profile, const double ns)
+{
+    profile->count++;
+    profile->total_ns += ns;
+    profile->max_ns = ns > profile->max_ns ? ns : profile->max_ns;
+}
+
+static void print_profile(const char *const name, const Profile *const profile, const double unit, const char *const unit_name)
+{
+    if (profile->count == 0)
+    {
+        return;
+    }
+    printf("  %-12s %6ld %10.3f %10.3f %10.3f  %s\n", name, profile->count, profile->total_ns / unit,
+           profile->total_ns / profile->count / unit, profile->max_ns / unit, unit_name);
+}
+
+static void render_if_dirty(HostFrame *const frame, Profile *const frames)
+{
+    if (host_take_dirty())
+    {
+        const double start = now_ns();
+        host_render(frame);
+        profile_add(frames, now_ns() - start);
+    }
+}
+
+// The trace of the replayed face, from its ring.
+static Trace replayed_trace(void)
+{
+    Trace trace = {0};
+    uint8_t buffer[TRACE_CHUNK_SIZE];
+    bool complete = false;
+    uint16_t size;
+    for (int chunk = 0; (size = trace_read_chunk(chunk, buffer)) > 0; chunk++)
+    {
+        trace_add_chunk(&trace, buffer, size, &complete);
+    }
+    return trace;
+}
+
+// Frames are left out: the watch draws when the firmware gets to it, the
+// replay right after each event.
+static int compare_traces(const Trace *const input, const int64_t *const input_times, const Trace *const output)
+{
+    int64_t *const output_times = trace_times(output);
+    int i = 0;
+    int j = 0;
+    int compared = 0;
+    for (;;)
+    {
+        while (i < input->count && draw_event(input->records[i].event))
+            i++;
+        while (j < output->count && draw_event(output->records[j].event))
+            j++;
+        if (i == input->count || j == output->count)
+        {
+            break;
+        }
+        const TraceRecord *const a = &input->records[i];
+        const TraceRecord *const b = &output->records[j];
+        if (a->event != b->event || a->detail != b->detail || a->value != b->value || input_times[i] != output_times[j])
+        {
+            printf("replay differs at record %d, the settings may not be the watch's:\n  traced   ", i);
+            print_record(a, input_times[i]);
+            printf("  replayed ");
+            print_record(b, output_times[j]);
+            free(output_times);
+            return -1;
+        }
+        compared++;
+        i++;
+        j++;
+    }
+    free(output_times);
+    if (i != input->count || j != output->count)
+    {
+        printf("replay traced %s events than the watch\n", i != input->count ? "fewer" : "more");
+        return -1;
+    }
+    return compared;
+}
+
+static int replay(const Trace *const trace, const char *const settings)
+{
+    int64_t *const times = trace_times(trace);
+    set_timezone(trace->header.utc_offset);
+    if (!prepare_watch(settings, times[0] / 1000))
+    {
+        free(times);
+        return 1;
+    }
+    host_watch.now_ms = times[0] % 1000;
+    init();
+    host_take_dirty();
+
+    Profile events[EVENT_COUNT] = {0};
+    Profile timers = {0};
+    Profile frames = {0};
+    Profile watch_frames = {0};
+    int64_t draw_start = -1;
+    HostFrame *const frame = host_frame_create();
+    for (int i = 0; i < trace->count; i++)
+    {
+        const TraceRecord *const record = &trace->records[i];
+        double start = now_ns();
+        const int fired = host_advance(times[i] / 1000, times[i] % 1000);
+        if (fired > 0)
+        {
+            profile_add(&timers, now_ns() - start);
+            render_if_dirty(frame, &frames);
+        }
+        if (record->event == TraceEventDrawStart)
+        {
+            draw_start = times[i];
+            continue;
+        }
+        if (record->event == TraceEventDrawEnd)
+        {
+            if (draw_start >= 0)
+            {
+                profile_add(&watch_frames, (times[i] - draw_start) * 1e6);
+            }
+            draw_start = -1;
+            continue;
+        }
+        // A message traces one record per tuple, all at the same time.
+        const bool message_done = i + 1 == trace->count || trace->records[i + 1].event != TraceEventMessage ||
+                                  times[i + 1] != times[i];
+        start = now_ns();
+        replay_record(record, message_done);
+        profile_add(&events[record->event < EVENT_COUNT ? record->event : 0], now_ns() - start);
+        render_if_dirty(frame, &frames);
+    }
+    host_frame_destroy(frame);
+
+    Trace output = replayed_trace();
+    const int compared = compare_traces(trace, times, &output);
+    free(output.records);
+    deinit();
+
+    const int64_t span = (times[trace->count - 1] - times[0]) / 1000;
+    printf("%-8s %d records over %02d:%02d:%02d, %u recorded since launch, UTC%+d min\n", PLATFORM, trace->count,
+           (int)(span / 3600), (int)(span / 60 % 60), (int)(span % 60), trace->header.recorded, trace->header.utc_offset);
+    printf("  %-12s %6s %10s %10s %10s\n", "", "count", "total", "mean", "max");
+    for (unsigned int event = 0; event < EVENT_COUNT; event++)
+    {
+        if (!draw_event(event))
+        {
+            print_profile(event_name(event), &events[event], 1e3, "us");
+        }
+    }
+    print_profile("timers", &timers, 1e3, "us");
+    print_profile("frames", &frames, 1e3, "us");
+    // The host draws in no time, so its own traces have no watch frame times.
+    if (watch_frames.max_ns > 0)
+    {
+        print_profile("watch frames", &watch_frames, 1e6, "ms");
+    }
+    else if (watch_frames.count > 0)
+    {
+        printf("  %-12s %6ld  not timed, the trace was not made on a watch\n", "watch frames", watch_frames.count);
+    }
+    if (compared >= 0)
+    {
+        printf("  replay matches the %d traced events\n", compared);
+    }
+    free(times);
+    return compared < 0 ? 1 : 0;
+}
+
+// Command line
+
+int main(int argc, char **argv)
+{
+    bool print = false;
+    int option;
+    while ((option = getopt(argc, argv, "pr:")) != -1)
+    {
+        switch (option)
+        {
+        case 'p':
+            print = true;
+            break;
+        case 'r':
+            host_resources = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p] [-r RESOURCES] LOG [name=value...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-p] [-r RESOURCES] LOG [name=value...]\n", argv[0]);
+        return 2;
+    }
+    Trace trace = {0};
+    if (!trace_load(&trace, argv[optind]) || trace.count == 0)
+    {
+        free(trace.records);
+        return 1;
+    }
+    int status = 0;
+    if (print)
+    {
+        int64_t *const times = trace_times(&trace);
+        set_timezone(trace.header.utc_offset);
+        for (int i = 0; i < trace.count; i++)
+        {
+            print_record(&trace.records[i], times[i]);
+        }
+        free(times);
+    }
+    else
+    {
+        char settings[256];
+        join_settings(settings, sizeof(settings), argv + optind + 1, argc - optind - 1);
+        status = replay(&trace, settings);
+    }
+    free(trace.records);
+    return status;
+}
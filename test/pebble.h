@@ -1,10 +1,11 @@
 #include <sys/types.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
 
+#define PERSIST_DATA_MAX_LENGTH 256
 
-typedef enum { false, true } bool;
-typedef enum { E_DOES_NOT_EXIST } StatusCode;
+typedef enum { E_DOES_NOT_EXIST = -10 } StatusCode;
 
 typedef struct {
   int hex;
@@ -0,0 +1,99 @@
+"use strict";
+
+// node test/pkjs/energy_test.js
+
+var assert = require('assert');
+var energy = require('../../src/pkjs/energy.js');
+
+var COUNTERS = energy.COUNTERS.length;
+
+// An EnergyDay with the given settings, { hour: [refresh rate, flags] }, and
+// counts, { hour: { counter: count } }.
+var energyDay = function (day, settings, counts) {
+    var bytes = [2, COUNTERS, 0, 0, day & 0xff, day >> 8 & 0xff, day >> 16 & 0xff, day >> 24 & 0xff];
+    for (var hour = 0; hour < 24; hour++) {
+        bytes = bytes.concat(settings[hour] || [0, 0]);
+    }
+    for (hour = 0; hour < 24; hour++) {
+        energy.COUNTERS.forEach(function (name) {
+            var count = (counts[hour] || {})[name] || 0;
+            bytes.push(count & 0xff, count >> 8);
+        });
+    }
+    return bytes;
+};
+
+var day = new Date(2026, 9, 18).getTime() / 1000;
+var bytes = energyDay(day, {
+    // Normal, with weather and health.
+    0: [30, 0x18],
+    // Saving, with the rainbow hand.
+    7: [30, 0x1d],
+    // Sleeping, with the rainbow hand, after the refresh rate changed.
+    23: [60, 0x1e]
+}, {
+    0: { frames: 60, kilopixels: 1451, ticks: 60 },
+    7: { frames: 61, messagesOut: 2, bytesOut: 24, vibrations: 1 },
+    23: { redrawRainbow: 60, persistWrites: 3, persistBytes: 65535 }
+});
+
+// Parsing
+var report = energy.parse(bytes);
+assert.strictEqual(report.day, day);
+assert.strictEqual(report.hours.length, 24);
+assert.strictEqual(report.hours[0].kilopixels, 1451);
+assert.strictEqual(report.hours[7].vibrations, 1);
+assert.strictEqual(report.hours[23].persistBytes, 65535);
+assert.strictEqual(report.hours[12].frames, 0);
+assert.deepStrictEqual(report.settings[0], { refreshRate: 30, profile: 'normal', rainbow: false, weather: true, health: true });
+assert.deepStrictEqual(report.settings[7], { refreshRate: 30, profile: 'saving', rainbow: true, weather: true, health: true });
+assert.strictEqual(report.settings[23].profile, 'sleeping');
+assert.strictEqual(report.settings[12], null);
+
+// Negative values from the AppMessage bridge read as bytes.
+var signed = bytes.map(function (b) { return b > 127 ? b - 256 : b; });
+assert.deepStrictEqual(energy.parse(signed), report);
+
+// Unknown versions and layouts are ignored.
+assert.strictEqual(energy.parse(null), null);
+assert.strictEqual(energy.parse([1].concat(bytes.slice(1))), null);
+assert.strictEqual(energy.parse([2, COUNTERS + 1].concat(bytes.slice(2))), null);
+assert.strictEqual(energy.parse(bytes.slice(0, -2)), null);
+
+// The log keeps the raw counts.
+assert.strictEqual(energy.format([2, COUNTERS, 0, 0, -1]), 'energy-day 02' + COUNTERS.toString(16) + '0000ff');
+
+// Settings of the hours the face ran in.
+var active = energy.active(report);
+assert.deepStrictEqual(active.refreshRates, [30, 60]);
+assert.strictEqual(active.hours, 3);
+assert.strictEqual(active.rainbowHours, 2);
+assert.deepStrictEqual(active.profileHours, { normal: 1, saving: 1, sleeping: 1 });
+
+// Totals
+var totals = energy.totals(report);
+assert.strictEqual(totals.frames, 121);
+assert.strictEqual(totals.ticks, 60);
+assert.strictEqual(totals.messagesOut, 2);
+
+// Estimates
+var costs = energy.estimate(report);
+assert.strictEqual(costs.display, Math.round(121 * 1.0 + 1451 * 0.02));
+assert.strictEqual(costs.rainbow, 120);
+assert.strictEqual(costs.radio, Math.round(2 * 20 + 24 * 0.05));
+assert.strictEqual(costs.vibration, 30);
+assert.strictEqual(costs.health, 0);
+assert.strictEqual(costs.total, costs.display + costs.rainbow + costs.radio + costs.storage +
+    costs.health + costs.vibration + costs.wakeups);
+
+// Summary, with the settings of the day, from the most expensive subsystem.
+var line = energy.summary(report);
+assert.ok(line.indexOf('energy 2026-10-18 (refresh 30/60 min, rainbow on 2 h, saving 1 h, sleeping 1 h): ' +
+    costs.total + ' µAh, ') === 0, line);
+assert.ok(line.indexOf('storage') < line.indexOf('display'), line);
+assert.ok(line.indexOf('health 0') > 0, line);
+
+line = energy.summary(energy.parse(energyDay(day, { 9: [30, 0x0c], 10: [30, 0x0c] }, {})));
+assert.ok(line.indexOf('energy 2026-10-18 (refresh 30 min, rainbow on): 0 µAh, ') === 0, line);
+
+console.log('all tests passed');
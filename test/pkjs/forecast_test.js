@@ -0,0 +1,41 @@
+"use strict";
+
+// node test/pkjs/forecast_test.js
+
+var assert = require('assert');
+var forecast = require('../../src/pkjs/forecast.js');
+
+var now = 1760000000;
+var slot = Math.floor(now / 900) * 900 - 900;
+
+// A reading from the previous slot is still valid from when it was fetched.
+var reading = forecast.read({
+    current: { time: slot, temperature_2m: 12.6, weather_code: 3, is_day: 0 }
+}, now);
+assert.strictEqual(reading.fetched, now);
+assert.strictEqual(reading.observed, slot);
+assert.strictEqual(reading.temperature, 13);
+assert.strictEqual(reading.code, 3);
+assert.strictEqual(reading.isDay, false);
+
+// Without an observation time, it is the fetch time.
+reading = forecast.read({ current: { temperature_2m: -0.6, weather_code: 0, is_day: 1 } }, now);
+assert.strictEqual(reading.observed, now);
+assert.strictEqual(reading.temperature, -1);
+assert.strictEqual(reading.isDay, true);
+
+// The cache is fresh for the refresh rate from the fetch, however old the
+// slot it holds.
+assert.ok(forecast.fresh({ fetched: now - 599 }, now, 600));
+assert.ok(!forecast.fresh({ fetched: now - 600 }, now, 600));
+assert.ok(!forecast.fresh(null, now, 600));
+// Entries from before the fetch time was recorded are stale.
+assert.ok(!forecast.fresh({ timestamp: now }, now, 600));
+
+// Entries are only served with two minutes left before the watch takes them
+// as expired.
+assert.ok(forecast.servable({ fetched: now - 1079 }, now, 1200));
+assert.ok(!forecast.servable({ fetched: now - 1080 }, now, 1200));
+assert.ok(!forecast.servable({ fetched: now }, now, 60));
+
+console.log('all tests passed');
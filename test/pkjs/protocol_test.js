@@ -0,0 +1,53 @@
+"use strict";
+
+// node test/pkjs/protocol_test.js
+
+var assert = require('assert');
+
+var storage = {};
+global.localStorage = {
+    getItem: function (key) {
+        return storage.hasOwnProperty(key) ? storage[key] : null;
+    },
+    setItem: function (key, value) {
+        storage[key] = String(value);
+    }
+};
+
+var protocol = require('../../src/pkjs/protocol.js');
+
+var PACKED = [1, 'c'.charCodeAt(0), -3 & 0xff, 0, 0x10, 0x20, 0x30, 0x40];
+
+// Nothing announced yet: today's per-key tuples.
+var legacy = protocol.load();
+assert.strictEqual(legacy.version, 0);
+assert.deepStrictEqual(protocol.encodeWeather(legacy, { AppKeyJsReady: 1, AppKeyWeather: PACKED, AppKeyLocation: [1, 2, 3, 4] }), {
+    AppKeyJsReady: 1,
+    AppKeyWeatherIcon: 'c'.charCodeAt(0),
+    AppKeyWeatherTemperature: -3
+});
+assert.deepStrictEqual(protocol.encodeWeather(legacy, { AppKeyWeather: [1, 0, 0, 1, 0, 0, 0, 0] }), { AppKeyWeatherFailed: 1 });
+assert.ok(protocol.fits(legacy, { AppKeyWeather: PACKED }));
+
+// Matches PROTOCOL_VERSION << 24 | PROTOCOL_FEATURES << 16 | MESSENGER_INBOX_SIZE on the watch.
+var announced = protocol.parse(1 << 24 | 7 << 16 | 2048);
+assert.deepStrictEqual(announced, { version: 1, features: 7, inboxSize: 2048 });
+protocol.save(announced);
+var current = protocol.load();
+assert.deepStrictEqual(current, announced);
+assert.ok(protocol.supports(current, protocol.FEATURES.DELTA_CONFIG));
+assert.deepStrictEqual(protocol.encodeWeather(current, { AppKeyWeather: PACKED, AppKeyLocation: [1, 2, 3, 4] }), {
+    AppKeyWeather: PACKED,
+    AppKeyLocation: [1, 2, 3, 4]
+});
+
+// Packed weather without location support.
+var partial = protocol.parse(1 << 24 | protocol.FEATURES.PACKED_WEATHER << 16 | 64);
+assert.deepStrictEqual(protocol.encodeWeather(partial, { AppKeyWeather: PACKED, AppKeyLocation: [1, 2, 3, 4] }), { AppKeyWeather: PACKED });
+
+// Dictionary size against the announced inbox.
+assert.strictEqual(protocol.dictSize({ AppKeyJsReady: 1, AppKeyWeather: PACKED }), 1 + 7 + 4 + 7 + 8);
+assert.ok(protocol.fits(partial, { AppKeyJsReady: 1, AppKeyWeather: PACKED }));
+assert.ok(!protocol.fits(protocol.parse(16), { AppKeyJsReady: 1, AppKeyWeather: PACKED }));
+
+console.log('all tests passed');
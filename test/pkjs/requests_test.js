@@ -0,0 +1,204 @@
+"use strict";
+
+// Runs the phone side request manager against a local stand-in server that
+// can be told to answer, stall or fail: node test/pkjs/requests_test.js
+
+var assert = require('assert');
+var http = require('http');
+var RequestManager = require('../../src/pkjs/requests.js');
+var forecast = require('../../src/pkjs/forecast.js');
+
+// Just enough of XMLHttpRequest for the request manager.
+var NodeRequest = function () {
+    var self = this;
+    var url = null;
+    var req = null;
+    self.status = 0;
+    self.responseText = '';
+    self.open = function (method, target) {
+        url = target;
+    };
+    self.send = function () {
+        req = http.get(url, function (res) {
+            var body = '';
+            res.on('data', function (chunk) { body += chunk; });
+            res.on('end', function () {
+                self.status = res.statusCode;
+                self.responseText = body;
+                if (self.onload) {
+                    self.onload();
+                }
+            });
+        });
+        req.on('error', function () {
+            if (self.onerror) {
+                self.onerror();
+            }
+        });
+    };
+    self.abort = function () {
+        if (req) {
+            req.destroy();
+        }
+    };
+};
+
+var stalled = [];
+
+var server = http.createServer(function (req, res) {
+    if (req.url.indexOf('/stall') === 0) {
+        stalled.push(res);
+        return;
+    }
+    if (req.url.indexOf('/fail') === 0) {
+        res.writeHead(500);
+        res.end();
+        return;
+    }
+    if (req.url.indexOf('/shape') === 0) {
+        res.writeHead(200);
+        res.end('{"features": []}');
+        return;
+    }
+    if (req.url.indexOf('/garbage') === 0) {
+        res.writeHead(200);
+        res.end('{not json');
+        return;
+    }
+    res.writeHead(200);
+    res.end(JSON.stringify({ path: req.url }));
+});
+
+var tests = [];
+var test = function (name, body) {
+    tests.push({ name: name, body: body });
+};
+
+var base;
+
+test('succeeds', function (done) {
+    var requests = RequestManager(function () { return new NodeRequest(); });
+    requests.getJson('forecast', base + '/ok', 1000, function (response) {
+        assert.strictEqual(response.path, '/ok');
+        assert.strictEqual(requests.pending('forecast'), false);
+        done();
+    }, function (err) {
+        done(new Error(err));
+    });
+});
+
+test('reports server failures', function (done) {
+    var requests = RequestManager(function () { return new NodeRequest(); });
+    requests.getJson('forecast', base + '/fail', 1000, function () {
+        done(new Error('unexpected success'));
+    }, function (err) {
+        assert.ok(/status 500/.test(err), err);
+        done();
+    });
+});
+
+test('reports invalid responses', function (done) {
+    var requests = RequestManager(function () { return new NodeRequest(); });
+    requests.getJson('forecast', base + '/garbage', 1000, function () {
+        done(new Error('unexpected success'));
+    }, function (err) {
+        assert.ok(/invalid response/.test(err), err);
+        done();
+    });
+});
+
+test('reports responses of the wrong shape', function (done) {
+    var requests = RequestManager(function () { return new NodeRequest(); });
+    requests.getJson('forecast', base + '/shape', 1000, function (response) {
+        forecast.read(response, 0);
+        done(new Error('unexpected success'));
+    }, function (err) {
+        assert.ok(/forecast error: unexpected response/.test(err), err);
+        assert.strictEqual(requests.pending('forecast'), false);
+        done();
+    });
+});
+
+test('fails a stalled request at its deadline', function (done) {
+    var requests = RequestManager(function () { return new NodeRequest(); });
+    var started = Date.now();
+    requests.getJson('geocode', base + '/stall', 200, function () {
+        done(new Error('unexpected success'));
+    }, function (err) {
+        var elapsed = Date.now() - started;
+        assert.ok(/timed out/.test(err), err);
+        assert.ok(elapsed >= 190 && elapsed < 1000, 'elapsed ' + elapsed);
+        assert.strictEqual(requests.pending('geocode'), false);
+        done();
+    });
+});
+
+test('cancels a superseded request of the same kind', function (done) {
+    var requests = RequestManager(function () { return new NodeRequest(); });
+    requests.getJson('forecast', base + '/stall', 1000, function () {
+        done(new Error('superseded request succeeded'));
+    }, function (err) {
+        done(new Error('superseded request reported: ' + err));
+    });
+    requests.getJson('forecast', base + '/second', 1000, function (response) {
+        assert.strictEqual(response.path, '/second');
+        // Give the superseded request a chance to wrongly call back.
+        setTimeout(done, 100);
+    }, function (err) {
+        done(new Error(err));
+    });
+});
+
+test('keeps requests of different kinds independent', function (done) {
+    var requests = RequestManager(function () { return new NodeRequest(); });
+    var remaining = 2;
+    var finished = function () {
+        remaining--;
+        if (remaining === 0) {
+            done();
+        }
+    };
+    requests.getJson('geocode', base + '/geocode', 1000, finished, function (err) { done(new Error(err)); });
+    requests.getJson('forecast', base + '/forecast', 1000, finished, function (err) { done(new Error(err)); });
+});
+
+test('bounds work that never answers, like geolocation', function (done) {
+    var requests = RequestManager();
+    requests.run('geolocation', 100, function () {
+    }, function () {
+        done(new Error('unexpected success'));
+    }, function (err) {
+        assert.ok(/geolocation timed out/.test(err), err);
+        done();
+    });
+});
+
+var run = function (index, failures) {
+    if (index === tests.length) {
+        stalled.forEach(function (res) { res.destroy(); });
+        server.close();
+        console.log(failures === 0 ? 'all tests passed' : failures + ' test(s) failed');
+        process.exitCode = failures === 0 ? 0 : 1;
+        return;
+    }
+    var current = tests[index];
+    var finished = false;
+    var done = function (err) {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        console.log((err ? 'FAIL ' : 'ok   ') + current.name + (err ? ': ' + err.message : ''));
+        run(index + 1, failures + (err ? 1 : 0));
+    };
+    try {
+        current.body(done);
+    } catch (e) {
+        done(e);
+    }
+};
+
+server.listen(0, '127.0.0.1', function () {
+    base = 'http://127.0.0.1:' + server.address().port;
+    run(0, 0);
+});
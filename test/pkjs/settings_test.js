@@ -0,0 +1,70 @@
+"use strict";
+
+// node test/pkjs/settings_test.js
+
+var assert = require('assert');
+var settings = require('../../src/pkjs/settings.js');
+
+var saved = {
+    AppKeyMinuteHandColor: 0xffffff,
+    AppKeyHourHandColor: 0xff0000,
+    AppKeyBackgroundColor: 0x000000,
+    AppKeyTimeColor: 0xaaaaaa,
+    AppKeyInfoColor: 0x555555,
+    AppKeyDateDisplayed: 1,
+    AppKeyRefreshRate: 30
+};
+
+var copy = function (object) {
+    return JSON.parse(JSON.stringify(object));
+};
+
+assert.strictEqual(settings.toGColor8(0x000000), 0xc0);
+assert.strictEqual(settings.toGColor8(0xffffff), 0xff);
+assert.strictEqual(settings.toGColor8(0xff5500), 0xf4);
+
+// First sync sends everything, colors packed.
+var first = settings.delta(saved, null);
+assert.deepStrictEqual(first.AppKeyPalette, [0xff, 0xf0, 0xc0, 0xea, 0xd5]);
+assert.strictEqual(first.AppKeyMinuteHandColor, undefined);
+assert.strictEqual(first.AppKeyDateDisplayed, 1);
+assert.strictEqual(first.AppKeyRefreshRate, 30);
+
+// An unchanged save sends nothing.
+assert.strictEqual(settings.delta(copy(saved), saved), null);
+
+// A single toggle only sends that key.
+var toggled = copy(saved);
+toggled.AppKeyDateDisplayed = 0;
+assert.deepStrictEqual(settings.delta(toggled, saved), { AppKeyDateDisplayed: 0 });
+
+// A theme change is a single palette tuple.
+var themed = copy(saved);
+themed.AppKeyBackgroundColor = 0x000055;
+themed.AppKeyTimeColor = 0xffff00;
+assert.deepStrictEqual(Object.keys(settings.delta(themed, saved)), ['AppKeyPalette']);
+
+// The checksum answering a save is the synced one, the one sent at launch has
+// to match it.
+var storage = {};
+global.localStorage = {
+    getItem: function (key) { return storage[key] !== undefined ? storage[key] : null; },
+    setItem: function (key, value) { storage[key] = String(value); }
+};
+assert.strictEqual(settings.watchConfigDiffers(0x1234), false);
+settings.saveLastSynced(saved);
+assert.strictEqual(settings.watchConfigDiffers(0x1234), true);
+assert.strictEqual(settings.watchConfigDiffers(1 << 16 | 0x1234), false);
+assert.strictEqual(settings.watchConfigDiffers(0x1234), false);
+// After the watch fell back to its defaults.
+assert.strictEqual(settings.watchConfigDiffers(0x4321), true);
+
+// One-shot toggles are turned off in what Clay shows next time.
+storage['clay-settings'] = JSON.stringify({ AppKeyTrace: true, AppKeyDateDisplayed: true });
+settings.resetToggle('AppKeyTrace');
+assert.deepStrictEqual(JSON.parse(storage['clay-settings']), { AppKeyTrace: false, AppKeyDateDisplayed: true });
+delete storage['clay-settings'];
+settings.resetToggle('AppKeyTrace');
+assert.strictEqual(storage['clay-settings'], undefined);
+
+console.log('all tests passed');
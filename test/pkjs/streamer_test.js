@@ -0,0 +1,140 @@
+"use strict";
+
+// node test/pkjs/streamer_test.js
+
+var assert = require('assert');
+var Streamer = require('../../src/pkjs/streamer.js');
+
+var INTERVAL = 50;
+
+var tests = [];
+var test = function (name, body) {
+    tests.push({ name: name, body: body });
+};
+
+test('coalesces a burst into the latest value per key', function (done) {
+    var sent = [];
+    var streamer = Streamer(function (message, ok) {
+        sent.push({ message: message, at: Date.now() });
+        setTimeout(ok, 5);
+    }, INTERVAL);
+    for (var i = 0; i < 100; i++) {
+        streamer.push({ AppKeyTimeColor: i, AppKeyRainbowMode: i % 2 });
+    }
+    setTimeout(function () {
+        assert.strictEqual(sent.length, 1);
+        assert.deepStrictEqual(sent[0].message, { AppKeyTimeColor: 99, AppKeyRainbowMode: 1 });
+        done();
+    }, INTERVAL * 3);
+});
+
+test('never sends more than one message per interval', function (done) {
+    var sent = [];
+    var streamer = Streamer(function (message, ok) {
+        sent.push(Date.now());
+        ok();
+    }, INTERVAL);
+    var pushes = 0;
+    var pusher = setInterval(function () {
+        streamer.push({ AppKeyInfoColor: pushes++ });
+    }, 5);
+    setTimeout(function () {
+        clearInterval(pusher);
+        for (var i = 1; i < sent.length; i++) {
+            assert.ok(sent[i] - sent[i - 1] >= INTERVAL - 5, 'sent ' + (sent[i] - sent[i - 1]) + ' ms apart');
+        }
+        assert.ok(sent.length <= 500 / INTERVAL + 1, sent.length + ' messages');
+        done();
+    }, 500);
+});
+
+test('waits for the message in flight', function (done) {
+    var inFlight = 0;
+    var ack = null;
+    var streamer = Streamer(function (message, ok) {
+        inFlight++;
+        assert.strictEqual(inFlight, 1);
+        ack = function () {
+            inFlight--;
+            ok();
+        };
+    }, 0);
+    streamer.push({ a: 1 });
+    setTimeout(function () {
+        streamer.push({ a: 2 });
+        setTimeout(function () {
+            assert.strictEqual(streamer.stats.sent, 1);
+            ack();
+            setTimeout(function () {
+                assert.strictEqual(streamer.stats.sent, 2);
+                done();
+            }, 10);
+        }, 10);
+    }, 10);
+});
+
+test('resends failed values unless newer ones were pushed', function (done) {
+    var sent = [];
+    var fail = true;
+    var streamer = Streamer(function (message, ok, nack) {
+        sent.push(message);
+        if (fail) {
+            fail = false;
+            streamer.push({ b: 3 });
+            nack();
+        } else {
+            ok();
+        }
+    }, 0);
+    var acked = false;
+    streamer.push({ a: 1, b: 2 }, function () {
+        acked = true;
+    });
+    setTimeout(function () {
+        assert.strictEqual(sent.length, 2);
+        assert.deepStrictEqual(sent[1], { a: 1, b: 3 });
+        assert.ok(acked);
+        done();
+    }, 50);
+});
+
+test('drops a message the watch keeps rejecting', function (done) {
+    var attempts = 0;
+    var streamer = Streamer(function (message, ok, nack) {
+        attempts++;
+        nack();
+    }, 1);
+    streamer.push({ a: 1 }, function () {
+        done(new Error('unexpected ack'));
+    });
+    setTimeout(function () {
+        assert.strictEqual(attempts, 5);
+        assert.strictEqual(streamer.stats.dropped, 1);
+        done();
+    }, 200);
+});
+
+var run = function (index, failures) {
+    if (index === tests.length) {
+        console.log(failures === 0 ? 'all tests passed' : failures + ' test(s) failed');
+        process.exitCode = failures === 0 ? 0 : 1;
+        return;
+    }
+    var current = tests[index];
+    var finished = false;
+    var done = function (err) {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        console.log((err ? 'FAIL ' : 'ok   ') + current.name + (err ? ': ' + err.message : ''));
+        run(index + 1, failures + (err ? 1 : 0));
+    };
+    try {
+        current.body(done);
+    } catch (e) {
+        done(e);
+    }
+};
+
+run(0, 0);
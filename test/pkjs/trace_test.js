@@ -0,0 +1,17 @@
+"use strict";
+
+// node test/pkjs/trace_test.js
+
+var assert = require('assert');
+var trace = require('../../src/pkjs/trace.js');
+
+// Header of chunk 2 of 3, followed by one tick record.
+var chunk = [1, 1, 3, 1, 0x00, 0x2d, 0xc2, 0x67, 0x41, 0x01, 0, 0, 0x3c, 0x00,
+    0xe8, 0x03, 0, 0, 1, 2, 0x58, 0x02];
+assert.strictEqual(trace.format(chunk),
+    'trace 0101030100' + '2dc26741010000' + '3c00' + 'e8030000' + '01025802' + ' (2/3)');
+
+// Negative values from the AppMessage bridge are still two hex digits.
+assert.strictEqual(trace.format([1, 0, 1, 0, -1]), 'trace 01000100ff (1/1)');
+
+console.log('all tests passed');